@@ -0,0 +1,45 @@
+#ifndef binlog_h
+#define binlog_h
+
+#include <Arduino.h>
+
+#include "binlog_formats.h"
+
+#define BINLOG_RING_SIZE 1024 // bytes
+#define BINLOG_HIGH_WATER (3 * BINLOG_RING_SIZE / 4) // binlog_write() drains the ring past this
+#define BINLOG_MAX_ARGS 10
+#define BINLOG_SYNC 0xB1 // first byte of each frame; text on the port is ASCII
+
+void binlog_write(const uint8_t format, const uint32_t *args, const uint8_t nargs);
+void binlog_drain();
+void binlog_flush();
+uint32_t binlog_drops();
+
+inline void binlog_args(uint32_t *)
+{
+}
+
+template <typename T, typename... Rest>
+inline void binlog_args(uint32_t *args, T first, Rest... rest)
+{
+    *args = (uint32_t)first;
+    binlog_args(args + 1, rest...);
+}
+
+/**
+ * @brief Log a message without formatting it.
+ * The format ID and up to BINLOG_MAX_ARGS integer arguments are copied
+ * into a RAM ring buffer; binlog_drain() sends them to the serial port.
+ * @param format One of the IDs in binlog_formats.h
+ * @param args The values for the format's conversions
+ */
+template <typename... Args>
+inline void binlog(const binlog_format format, Args... args)
+{
+    static_assert(sizeof...(Args) <= BINLOG_MAX_ARGS, "Too many binlog arguments");
+    uint32_t values[sizeof...(Args) + 1];
+    binlog_args(values, args...);
+    binlog_write(format, values, sizeof...(Args));
+}
+
+#endif
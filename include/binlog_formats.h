@@ -0,0 +1,38 @@
+#ifndef binlog_formats_h
+#define binlog_formats_h
+
+// The format strings for binlog(). Only the ID and the arguments are sent
+// by the device; tools/binlog_decode.py reads this file to turn them back
+// into text. Add new formats at the end so existing IDs don't change.
+// Arguments are sent as 32-bit unsigned values, so formats can only use
+// integer conversions.
+
+#define BINLOG_FORMATS(X)                                                                               \
+    X(BINLOG_DROPPED, "binlog: dropped %lu messages")                                                   \
+    X(BINLOG_JEDEC_ID, "  JEDEC ID:     %02X %02X %0X")                                                 \
+    X(BINLOG_MEMORY_SIZE, "  Memory Size:  %ld")                                                        \
+    X(BINLOG_BLOCK_SIZE, "  Block Size:   %ld")                                                         \
+    X(BINLOG_HEADER, "Header: year: %d, month %d, number of records: %d, size %d and type %02x")        \
+    X(BINLOG_RECORD_COUNT, "Expected records (%d) and number in header (%d) do not match")              \
+    X(BINLOG_RECORD_SIZE, "Record size for type %02x is %d, but the header says %d")                    \
+    X(BINLOG_READ_FAILED, "Failed to read record number: %d")                                           \
+    X(BINLOG_INVALID_MESSAGE, "Invalid message number: %d, expected: %d")                               \
+    X(BINLOG_INVALID_FILLER, "Invalid record filler")                                                   \
+    X(BINLOG_RECORD_01, "record number: %d, data: %02x %02x %02x %02x %02x %02x %02x %02x %02x")        \
+    X(BINLOG_EVENT, "event: %d, time: %lu, data bytes: %d")                                             \
+    X(BINLOG_EVENT_TOO_SHORT, "Event record too short: %d")                                             \
+    X(BINLOG_FILE_START, "File data-%02d-%02d.bin starts at 0x%08lx")                                   \
+    X(BINLOG_TEST_HEADER, "year: %d, Month %d, number of records: %d, record size %d and type %02x")     \
+    X(BINLOG_UNKNOWN_TYPE, "Unknown record type: %d")
+
+#define BINLOG_ENUM(name, format) name,
+
+enum binlog_format
+{
+    BINLOG_FORMATS(BINLOG_ENUM)
+    BINLOG_FORMAT_COUNT
+};
+
+#undef BINLOG_ENUM
+
+#endif
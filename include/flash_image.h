@@ -0,0 +1,46 @@
+#ifndef flash_image_h
+#define flash_image_h
+
+#include <Arduino.h>
+
+#include "flash_utils.h"
+
+// The serial protocol used to program a whole flash image onto a board.
+// The host (make_flash_image -d) sends commands; load_flash_image.cc on
+// the board answers each with FLASH_IMAGE_ACK or FLASH_IMAGE_NAK. Pages
+// that are all 0xFF are not sent since the chip is erased first.
+//
+// A page frame ends with the CRC (see flash_image_crc()) of its address
+// and data. The board NAKs a page if the CRC is wrong, the address is not
+// the start of a page inside the chip, or the page does not read back as
+// sent.
+
+#define FLASH_IMAGE_ERASE 'E' // erase the whole chip
+#define FLASH_IMAGE_PAGE 'P'  // uint32_t address, FLASH_PAGE_SIZE bytes, uint16_t CRC
+#define FLASH_IMAGE_DONE 'D'  // no more pages
+
+#define FLASH_IMAGE_ACK 0x06
+#define FLASH_IMAGE_NAK 0x15
+
+#define FLASH_IMAGE_CRC_INIT 0xFFFF
+
+/**
+ * @brief Add bytes to a CRC-16/CCITT (polynomial 0x1021)
+ * @param crc The CRC so far; start with FLASH_IMAGE_CRC_INIT
+ * @param data The bytes
+ * @param len The number of bytes
+ * @return The new CRC
+ */
+inline uint16_t flash_image_crc(uint16_t crc, const uint8_t *data, const uint32_t len)
+{
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
+
+#endif
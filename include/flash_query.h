@@ -0,0 +1,46 @@
+#ifndef flash_query_h
+#define flash_query_h
+
+#include <Arduino.h>
+
+// A query is one line of text:
+//
+//   q <type> <from> <to> [every [fields]]
+//
+// which asks for the records of 'type' whose time is between 'from' and 'to'
+// (seconds since the epoch, inclusive), sending only every Nth matching
+// record and only the listed fields (by number, e.g. 0,1). By default every
+// record and all the fields are sent.
+//
+// The answer is a series of binary frames:
+//
+//   QUERY_SYNC, frame type, payload length (uint16_t), payload, checksum
+//
+// where the checksum is the XOR of the payload bytes and multi-byte values
+// are little-endian. Payloads, like binlog frames, can hold any byte value,
+// so a decoder has to skip each frame of the other kind by its length
+// rather than scan it for a sync byte. The payloads are:
+//
+//   QUERY_FRAME_FILE    year, month, num_records (uint16_t each); one per file searched
+//   QUERY_FRAME_RECORD  index (uint16_t), time (uint32_t), the selected fields
+//   QUERY_FRAME_END     records sent (uint32_t), a query_status (uint8_t)
+
+#define QUERY_SYNC 0xB2 // first byte of each frame; text on the port is ASCII
+#define QUERY_COMMAND_SIZE 64 // longer lines are answered with QUERY_BAD_COMMAND
+
+#define QUERY_FRAME_FILE 'F'
+#define QUERY_FRAME_RECORD 'R'
+#define QUERY_FRAME_END 'E'
+
+enum query_status
+{
+    QUERY_OK,
+    QUERY_BAD_COMMAND,
+    QUERY_UNKNOWN_TYPE,
+    QUERY_READ_ERROR
+};
+
+bool run_query(const char *command, Print &out);
+void reject_query(Print &out);
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef flash_stats_h
+#define flash_stats_h
+
+#include <Arduino.h>
+
+// Build with -DFLASH_STATS=1 to count and trace flash operations. When it's
+// zero, the macros below expand to nothing and none of this is compiled.
+#ifndef FLASH_STATS
+#define FLASH_STATS 0
+#endif
+
+#define FLASH_TRACE_SIZE 64 // entries in the trace ring buffer
+
+enum flash_op
+{
+    FLASH_OP_SPACE_ON_FLASH,
+    FLASH_OP_ERASE_FLASH,
+    FLASH_OP_SETUP_SPI_FLASH,
+    FLASH_OP_MAKE_NEW_DATA_FILE,
+    FLASH_OP_WRITE_HEADER,
+    FLASH_OP_WRITE_RECORD,
+    FLASH_OP_READ_HEADER,
+    FLASH_OP_READ_RECORD,
+    FLASH_OP_COUNT
+};
+
+struct flash_op_stats
+{
+    uint32_t calls;
+    uint32_t total_us;
+    uint32_t max_us;
+};
+
+struct flash_stats
+{
+    uint32_t bytes_read;
+    uint32_t bytes_written;
+    uint32_t spi_transactions;
+    uint32_t page_programs;
+    uint32_t erases;
+    uint32_t busy_wait_us; // waiting for programs and erases to finish
+    flash_op_stats ops[FLASH_OP_COUNT];
+};
+
+// One trace entry is 12 bytes; the ring holds the most recent operations.
+struct flash_trace_entry
+{
+    uint32_t start_us;
+    uint16_t duration_us; // saturates at 0xFFFF
+    uint8_t op;           // a flash_op
+    uint8_t status;       // 1 if the operation worked
+    uint32_t arg;         // bytes moved, or the bytes erased for erases
+};
+
+#if FLASH_STATS
+
+extern flash_stats flash_counters;
+
+void flash_stats_reset();
+void flash_stats_dump();
+void flash_trace_dump();
+bool flash_stats_command(const int c);
+
+void flash_trace_add(const flash_op op, const uint32_t start_us, const bool status, const uint32_t arg);
+void flash_stats_count_transfer(const bool write, const uint32_t address, const uint32_t len);
+
+/**
+ * Times the enclosing scope and records it as one 'op'. Set 'status' and
+ * 'arg' before the scope ends to have them show up in the trace.
+ */
+class flash_op_timer
+{
+    flash_op d_op;
+    uint32_t d_start;
+
+public:
+    bool status;
+    uint32_t arg;
+
+    flash_op_timer(flash_op op) : d_op(op), d_start(micros()), status(true), arg(0) {}
+    ~flash_op_timer()
+    {
+        uint32_t elapsed = micros() - d_start;
+        flash_op_stats &s = flash_counters.ops[d_op];
+        ++s.calls;
+        s.total_us += elapsed;
+        if (elapsed > s.max_us)
+            s.max_us = elapsed;
+        flash_trace_add(d_op, d_start, status, arg);
+    }
+};
+
+#define FLASH_STATS_ADD(field, n) (flash_counters.field += (n))
+#define FLASH_STATS_TRANSFER(write, address, len) flash_stats_count_transfer((write), (address), (len))
+#define FLASH_STATS_TIMER(op) flash_op_timer flash_timer_(op)
+#define FLASH_STATS_RESULT(ok, n) (flash_timer_.status = (ok), flash_timer_.arg = (n))
+
+#else
+
+#define FLASH_STATS_ADD(field, n)
+#define FLASH_STATS_TRANSFER(write, address, len)
+#define FLASH_STATS_TIMER(op)
+#define FLASH_STATS_RESULT(ok, n)
+
+#endif
+
+#endif
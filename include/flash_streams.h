@@ -0,0 +1,22 @@
+#ifndef flash_streams_h
+#define flash_streams_h
+
+#include <Arduino.h>
+
+#include <SerialFlash.h>
+
+#include "flash_utils.h"
+
+#define FLASH_MAX_STREAMS 4
+#define FLASH_STREAM_BUFFER_SIZE (2 * FLASH_PAGE_SIZE) // bytes per stream
+
+int open_flash_stream(const char *filename, const uint16_t year, const uint16_t month,
+                      const uint16_t num_records, const uint16_t record_size, const uint16_t record_type);
+bool push_stream_record(const int stream, const char *record);
+bool service_flash_streams();
+bool close_flash_stream(const int stream);
+
+uint32_t stream_backlog(const int stream);
+uint32_t stream_drops(const int stream);
+
+#endif
@@ -7,24 +7,41 @@
 #include <SerialFlash.h>
 
 #define FLASH_FILE_HEADER_SIZE 5 * sizeof(uint16_t) // bytes
+#define FLASH_PAGE_SIZE 256 // bytes; one page program on the W25Q16
 #define RECORD_TYPE_01 01
+#define RECORD_TYPE_02 02
+#define RECORD_MAX_SIZE 256 // bytes; largest record a reader will buffer
+
+// What read_variable_record_from_file() found
+enum record_status
+{
+    RECORD_OK,
+    RECORD_END, // no more records in the file
+    RECORD_ERROR
+};
 
 uint32_t space_on_flash(bool verbose = false);
 void erase_flash();
 uint32_t setup_spi_flash(bool erase, bool verbose = false);
 
+bool is_leap(uint16_t year);
 uint8_t days_per_month(uint8_t month, uint16_t year);
 char *make_data_file_name(const int month, const int yy);
 
 bool make_new_data_file(SerialFlashFile &flashFile, const char *filename, const int size_of_file);
 bool make_new_data_file(SerialFlashFile &flashFile, const char *filename, const int num_records, const int record_size);
+bool make_new_variable_data_file(SerialFlashFile &flashFile, const char *filename, const int num_records,
+                                 const int max_record_size);
 
 bool write_header_to_file(SerialFlashFile &flashFile, const uint16_t year, const uint16_t month,
                           const uint16_t num_records, const uint16_t record_size, const uint16_t record_type);
 bool write_record_to_file(SerialFlashFile &flashFile, const char *record, const uint32_t record_size);
+bool write_variable_record_to_file(SerialFlashFile &flashFile, const char *record, const uint16_t record_size);
 
 bool read_header_from_file(SerialFlashFile &flashFile, uint16_t &year, uint16_t &month, uint16_t &num_records,
                            uint16_t &record_size, uint16_t &record_type);
 bool read_record_from_file(SerialFlashFile &flashFile, char *record, const uint32_t record_size);
+record_status read_variable_record_from_file(SerialFlashFile &flashFile, char *record, const uint16_t max_size,
+                                             uint16_t &record_size);
 
 #endif
\ No newline at end of file
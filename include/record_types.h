@@ -0,0 +1,51 @@
+#ifndef record_types_h
+#define record_types_h
+
+#include <Arduino.h>
+
+#include "flash_utils.h"
+
+#define RECORD_SIZE_VARIABLE 0 // length-prefixed records
+#define RECORD_TYPES_MAX 8
+#define RECORD_FIELDS_MAX 4
+
+/**
+ * A decoder checks and/or prints one record. The index is the zero-based
+ * position of the record in its file.
+ */
+typedef bool (*record_decoder)(const char *record, const uint16_t record_size, const uint16_t index, bool verbose);
+
+/**
+ * Returns the time of a record in seconds since the epoch. 'file_start' is
+ * the start of the month in the file's header.
+ */
+typedef uint32_t (*record_time)(const char *record, const uint16_t record_size, const uint16_t index,
+                                const uint32_t file_start);
+
+// A field is a run of bytes in a record. A size of zero means the rest of
+// the record, for the last field of a variable-length record.
+struct record_field
+{
+    uint8_t offset;
+    uint8_t size;
+};
+
+struct record_type_info
+{
+    uint16_t type;
+    uint16_t size; // bytes, or RECORD_SIZE_VARIABLE
+    const char *name;
+    record_decoder decode;
+    record_time time;
+    uint8_t num_fields;
+    record_field fields[RECORD_FIELDS_MAX];
+};
+
+bool register_record_type(const uint16_t type, const uint16_t size, const char *name, record_decoder decode,
+                          record_time time = nullptr);
+bool add_record_field(const uint16_t type, const uint8_t offset, const uint8_t size);
+const record_type_info *find_record_type(const uint16_t type);
+
+uint32_t month_start_time(const uint16_t month, const uint16_t yy);
+
+#endif
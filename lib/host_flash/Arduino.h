@@ -0,0 +1,85 @@
+#ifndef host_arduino_h
+#define host_arduino_h
+
+// The parts of Arduino.h the flash utilities use, for builds on a host.
+// SerialUSB reads stdin and writes stdout.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define DEC 10
+#define HEX 16
+
+#define F(s) (s)
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len);
+    virtual int availableForWrite() { return 0; }
+
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+
+    size_t println();
+    template <typename T>
+    size_t println(T value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(T value, int base) { return print(value, base) + println(); }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    size_t readBytes(char *buf, size_t len);
+    size_t readBytes(uint8_t *buf, size_t len) { return readBytes((char *)buf, len); }
+};
+
+class HostSerial : public Stream
+{
+public:
+    void begin(unsigned long) {}
+    operator bool() { return true; }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buf, size_t len) override;
+    int availableForWrite() override { return 4096; }
+
+    int available() override;
+    int read() override;
+};
+
+extern HostSerial SerialUSB;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline uint32_t __get_PRIMASK() { return 0; }
+inline void __set_PRIMASK(uint32_t) {}
+
+#endif
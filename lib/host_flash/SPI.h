@@ -0,0 +1,20 @@
+#ifndef host_spi_h
+#define host_spi_h
+
+// SerialFlash::begin() takes an SPIClass; on a host there is no bus.
+
+#include <stdint.h>
+
+#define SPI_CLOCK_DIV2 2
+#define SPI_CLOCK_DIV64 64
+
+class SPIClass
+{
+public:
+    void begin() {}
+    void setClockDivider(uint8_t) {}
+};
+
+extern SPIClass SPI;
+
+#endif
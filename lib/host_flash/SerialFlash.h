@@ -0,0 +1,79 @@
+#ifndef host_serial_flash_h
+#define host_serial_flash_h
+
+// A SerialFlash work-alike for host builds. The chip is a 2MB (W25Q16)
+// array in RAM that behaves like NOR flash: erased bytes are 0xFF and a
+// write can only clear bits. Files are kept using the same directory layout
+// as the SerialFlash library, so an image saved here can be programmed onto
+// a board and read there, and vice versa.
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#define HOST_FLASH_CAPACITY 2097152 // bytes
+#define HOST_FLASH_BLOCK_SIZE 65536 // bytes
+
+class SerialFlashFile
+{
+public:
+    SerialFlashFile() : address(0), length(0), offset(0), dirindex(0) {}
+    operator bool() { return address > 0; }
+
+    uint32_t read(void *buf, uint32_t rdlen);
+    uint32_t write(const void *buf, uint32_t wrlen);
+    void seek(uint32_t n) { offset = n; }
+    uint32_t position() { return offset; }
+    uint32_t size() { return length; }
+    uint32_t available() { return offset < length ? length - offset : 0; }
+    void erase();
+    void flush() {}
+    void close() {}
+    uint32_t getFlashAddress() { return address; }
+
+protected:
+    friend class SerialFlashChip;
+    uint32_t address; // where the file's data begins
+    uint32_t length;  // total length of the data in the flash chip
+    uint32_t offset;  // current read/write offset in the file
+    uint16_t dirindex;
+};
+
+class SerialFlashChip
+{
+public:
+    static bool begin(SPIClass &device, uint8_t pin = 6);
+    static uint32_t capacity(const uint8_t *id);
+    static uint32_t blockSize();
+    static void sleep() {}
+    static void wakeup() {}
+    static void readID(uint8_t *buf);
+    static void readSerialNumber(uint8_t *buf);
+    static void read(uint32_t addr, void *buf, uint32_t len);
+    static bool ready() { return true; }
+    static void wait() {}
+    static void write(uint32_t addr, const void *buf, uint32_t len);
+    static void eraseAll();
+    static void eraseBlock(uint32_t addr);
+
+    static SerialFlashFile open(const char *filename);
+    static bool create(const char *filename, uint32_t length, uint32_t align = 0);
+    static bool createErasable(const char *filename, uint32_t length)
+    {
+        return create(filename, length, blockSize());
+    }
+    static bool exists(const char *filename);
+    static void opendir() { dirindex = 0; }
+    static bool readdir(char *filename, uint32_t strsize, uint32_t &filesize);
+
+    // Host only: move the whole chip to and from an image file.
+    static bool load_image(const char *path);
+    static bool save_image(const char *path);
+    static const uint8_t *image();
+
+private:
+    static uint16_t dirindex; // for readdir()
+};
+
+extern SerialFlashChip SerialFlash;
+
+#endif
@@ -0,0 +1,148 @@
+// The host versions of the Arduino functions declared in Arduino.h.
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+HostSerial SerialUSB;
+SPIClass SPI;
+
+size_t Print::write(const uint8_t *buf, size_t len)
+{
+    size_t n = 0;
+    while (len--)
+        n += write(*buf++);
+    return n;
+}
+
+size_t Print::print(const char *s)
+{
+    return write((const uint8_t *)s, strlen(s));
+}
+
+size_t Print::print(char c)
+{
+    return write((uint8_t)c);
+}
+
+size_t Print::print(long n, int base)
+{
+    if (base == DEC && n < 0)
+        return print('-') + print((unsigned long)-n, base);
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    char buf[8 * sizeof(long) + 1];
+    char *p = &buf[sizeof(buf) - 1];
+    *p = '\0';
+    do
+    {
+        int digit = n % base;
+        *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        n /= base;
+    } while (n);
+
+    return print(p);
+}
+
+size_t Print::println()
+{
+    return write((const uint8_t *)"\r\n", 2);
+}
+
+size_t Stream::readBytes(char *buf, size_t len)
+{
+    size_t n = 0;
+    while (n < len)
+    {
+        int c = read();
+        if (c < 0)
+            break;
+        buf[n++] = c;
+    }
+    return n;
+}
+
+size_t HostSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HostSerial::write(const uint8_t *buf, size_t len)
+{
+    size_t n = fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+    return n;
+}
+
+/**
+ * @brief Non-blocking check for input on stdin
+ * @return 1 if a byte can be read (or stdin is at EOF), 0 otherwise.
+ */
+int HostSerial::available()
+{
+    struct pollfd fd = {STDIN_FILENO, POLLIN, 0};
+    return poll(&fd, 1, 0) > 0 ? 1 : 0;
+}
+
+/**
+ * @brief Read one byte, waiting for it
+ * @return The byte or -1 at EOF.
+ */
+int HostSerial::read()
+{
+    fflush(stdout);
+    uint8_t c;
+    return ::read(STDIN_FILENO, &c, 1) == 1 ? c : -1;
+}
+
+static uint64_t now_us()
+{
+    static struct timespec start = {0, 0};
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    if (start.tv_sec == 0 && start.tv_nsec == 0)
+        start = t;
+
+    return (uint64_t)(t.tv_sec - start.tv_sec) * 1000000 + (t.tv_nsec - start.tv_nsec) / 1000;
+}
+
+unsigned long millis()
+{
+    return now_us() / 1000;
+}
+
+unsigned long micros()
+{
+    return now_us();
+}
+
+void delay(unsigned long ms)
+{
+    usleep(ms * 1000);
+}
+
+void yield()
+{
+}
+
+static uint8_t pins[64];
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    pins[pin % sizeof(pins)] = value;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pins[pin % sizeof(pins)];
+}
@@ -0,0 +1,356 @@
+// SerialFlash for host builds; the flash chip is an array in RAM.
+
+/**
+ * The directory uses the same layout as the SerialFlash library:
+ *
+ *   0x0000: signature 0xFA96554C, then (string space / 4) << 16 | maxfiles
+ *   0x0008: hash table, one uint16_t per file; 0xFFFF marks an unused entry
+ *   0x0008 + maxfiles * 2: index, 10 bytes per file (address, length, string offset / 4)
+ *   0x0008 + maxfiles * 12: file names, null terminated, each 4-byte aligned
+ *
+ * The first file starts after the string space and every file starts on a
+ * page boundary (or a block boundary for erasable files). All values are
+ * little-endian, as they are on the SAMD21.
+ */
+
+#include <SerialFlash.h>
+
+#include "flash_utils.h"
+
+#define SIGNATURE 0xFA96554C
+#define DEFAULT_MAXFILES 600
+#define DEFAULT_STRINGS_SIZE 25560
+
+SerialFlashChip SerialFlash;
+
+uint16_t SerialFlashChip::dirindex = 0;
+
+static uint8_t flash[HOST_FLASH_CAPACITY];
+static bool flash_initialized = false;
+
+static void init_flash()
+{
+    if (!flash_initialized)
+    {
+        memset(flash, 0xFF, sizeof(flash));
+        flash_initialized = true;
+    }
+}
+
+static uint16_t read_uint16(uint32_t addr)
+{
+    uint16_t value;
+    SerialFlash.read(addr, &value, sizeof(value));
+    return value;
+}
+
+static uint32_t read_uint32(uint32_t addr)
+{
+    uint32_t value;
+    SerialFlash.read(addr, &value, sizeof(value));
+    return value;
+}
+
+static uint16_t filename_hash(const char *filename)
+{
+    // http://isthe.com/chongo/tech/comp/fnv/
+    uint32_t hash = 2166136261;
+    for (const char *p = filename; *p; p++)
+    {
+        hash ^= *p;
+        hash *= 16777619;
+    }
+    return (hash % (uint32_t)0xFFFE) + 1; // all values except 0000 & FFFF
+}
+
+/**
+ * @brief Get the directory parameters, writing the signature on a blank chip
+ * @return maxfiles in the low 16 bits and the string space / 4 in the high
+ * 16 bits, or 0 if the chip holds something else.
+ */
+static uint32_t check_signature()
+{
+    uint32_t sig[2];
+    SerialFlash.read(0, sig, sizeof(sig));
+    if (sig[0] == SIGNATURE)
+        return sig[1];
+
+    if (sig[0] == 0xFFFFFFFF)
+    {
+        sig[0] = SIGNATURE;
+        sig[1] = ((uint32_t)(DEFAULT_STRINGS_SIZE / 4) << 16) | DEFAULT_MAXFILES;
+        SerialFlash.write(0, sig, sizeof(sig));
+        return sig[1];
+    }
+
+    return 0;
+}
+
+static uint32_t first_unallocated_file_index(uint32_t maxfiles)
+{
+    uint32_t index = 0;
+    while (index < maxfiles && read_uint16(8 + index * 2) != 0xFFFF)
+        ++index;
+    return index;
+}
+
+static void read_filename(uint32_t maxfiles, uint16_t stroffset, char *buf, uint32_t size)
+{
+    uint32_t addr = 8 + maxfiles * 12 + stroffset * 4;
+    uint32_t i = 0;
+    for (; i + 1 < size && addr + i < HOST_FLASH_CAPACITY && flash[addr + i]; ++i)
+        buf[i] = flash[addr + i];
+    buf[i] = '\0';
+}
+
+bool SerialFlashChip::begin(SPIClass &, uint8_t)
+{
+    init_flash();
+    return true;
+}
+
+uint32_t SerialFlashChip::capacity(const uint8_t *)
+{
+    return HOST_FLASH_CAPACITY;
+}
+
+uint32_t SerialFlashChip::blockSize()
+{
+    return HOST_FLASH_BLOCK_SIZE;
+}
+
+void SerialFlashChip::readID(uint8_t *buf)
+{
+    // Winbond W25Q16
+    buf[0] = 0xEF;
+    buf[1] = 0x40;
+    buf[2] = 0x15;
+}
+
+void SerialFlashChip::readSerialNumber(uint8_t *buf)
+{
+    memset(buf, 0, 8);
+}
+
+void SerialFlashChip::read(uint32_t addr, void *buf, uint32_t len)
+{
+    init_flash();
+    uint8_t *p = (uint8_t *)buf;
+    for (uint32_t i = 0; i < len; ++i)
+        p[i] = addr + i < HOST_FLASH_CAPACITY ? flash[addr + i] : 0xFF;
+}
+
+/**
+ * @brief Program bytes. Like NOR flash, this can only clear bits.
+ */
+void SerialFlashChip::write(uint32_t addr, const void *buf, uint32_t len)
+{
+    init_flash();
+    const uint8_t *p = (const uint8_t *)buf;
+    for (uint32_t i = 0; i < len && addr + i < HOST_FLASH_CAPACITY; ++i)
+        flash[addr + i] &= p[i];
+}
+
+void SerialFlashChip::eraseAll()
+{
+    memset(flash, 0xFF, sizeof(flash));
+    flash_initialized = true;
+}
+
+void SerialFlashChip::eraseBlock(uint32_t addr)
+{
+    init_flash();
+    addr -= addr % HOST_FLASH_BLOCK_SIZE;
+    if (addr < HOST_FLASH_CAPACITY)
+        memset(&flash[addr], 0xFF, HOST_FLASH_BLOCK_SIZE);
+}
+
+SerialFlashFile SerialFlashChip::open(const char *filename)
+{
+    SerialFlashFile file;
+
+    uint32_t maxfiles = check_signature() & 0xFFFF;
+    if (!maxfiles)
+        return file;
+
+    uint16_t hash = filename_hash(filename);
+    for (uint32_t index = 0; index < maxfiles; ++index)
+    {
+        uint16_t entry = read_uint16(8 + index * 2);
+        if (entry == 0xFFFF)
+            break;
+        if (entry != hash)
+            continue;
+
+        uint32_t ent = 8 + maxfiles * 2 + index * 10;
+        char name[64];
+        read_filename(maxfiles, read_uint16(ent + 8), name, sizeof(name));
+        if (strcmp(name, filename) == 0)
+        {
+            file.address = read_uint32(ent);
+            file.length = read_uint32(ent + 4);
+            file.offset = 0;
+            file.dirindex = index;
+            break;
+        }
+    }
+
+    return file;
+}
+
+bool SerialFlashChip::exists(const char *filename)
+{
+    SerialFlashFile file = open(filename);
+    return file ? true : false;
+}
+
+bool SerialFlashChip::create(const char *filename, uint32_t length, uint32_t align)
+{
+    if (exists(filename))
+        return false;
+
+    uint32_t maxfiles = check_signature();
+    if (!maxfiles)
+        return false;
+    uint32_t stringsize = (maxfiles & 0xFFFF0000) >> 14;
+    maxfiles &= 0xFFFF;
+
+    uint32_t index = first_unallocated_file_index(maxfiles);
+    if (index >= maxfiles)
+        return false;
+
+    // compute where to store the filename and actual data
+    uint32_t address;
+    uint32_t straddr = 8 + maxfiles * 12;
+    if (index == 0)
+    {
+        address = straddr + stringsize;
+    }
+    else
+    {
+        uint32_t prev = 8 + maxfiles * 2 + (index - 1) * 10;
+        address = read_uint32(prev) + read_uint32(prev + 4);
+        straddr += read_uint16(prev + 8) * 4;
+        while (straddr < HOST_FLASH_CAPACITY && flash[straddr])
+            ++straddr;
+        straddr = (straddr + 1 + 3) & 0x0003FFFC;
+    }
+
+    if (align > 0)
+    {
+        address = (address + align - 1) / align * align;
+        length = (length + align - 1) / align * align;
+    }
+    else
+    {
+        // every file starts on a page, so two files never share a write page
+        address = (address + FLASH_PAGE_SIZE - 1) & ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+    }
+
+    uint32_t len = strlen(filename);
+    if (address + length > HOST_FLASH_CAPACITY || straddr + len + 1 > 8 + maxfiles * 12 + stringsize)
+        return false;
+
+    write(straddr, filename, len + 1);
+
+    uint8_t ent[10];
+    uint16_t stroffset = (straddr - (8 + maxfiles * 12)) / 4;
+    memcpy(&ent[0], &address, 4);
+    memcpy(&ent[4], &length, 4);
+    memcpy(&ent[8], &stroffset, 2);
+    write(8 + maxfiles * 2 + index * 10, ent, sizeof(ent));
+
+    uint16_t hash = filename_hash(filename);
+    write(8 + index * 2, &hash, sizeof(hash));
+
+    return true;
+}
+
+bool SerialFlashChip::readdir(char *filename, uint32_t strsize, uint32_t &filesize)
+{
+    uint32_t maxfiles = check_signature() & 0xFFFF;
+    if (!maxfiles || dirindex >= maxfiles || read_uint16(8 + dirindex * 2) == 0xFFFF)
+        return false;
+
+    uint32_t ent = 8 + maxfiles * 2 + dirindex * 10;
+    filesize = read_uint32(ent + 4);
+    read_filename(maxfiles, read_uint16(ent + 8), filename, strsize);
+    ++dirindex;
+
+    return true;
+}
+
+/**
+ * @brief Replace the contents of the chip with an image file
+ * A short file leaves the rest of the chip erased.
+ * @return True if the file was read, false otherwise.
+ */
+bool SerialFlashChip::load_image(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    eraseAll();
+    size_t n = fread(flash, 1, sizeof(flash), f);
+    bool status = !ferror(f);
+    fclose(f);
+
+    return status && n > 0;
+}
+
+/**
+ * @brief Write the whole chip to an image file
+ * @return True if the file was written, false otherwise.
+ */
+bool SerialFlashChip::save_image(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    init_flash();
+    size_t n = fwrite(flash, 1, sizeof(flash), f);
+    return fclose(f) == 0 && n == sizeof(flash);
+}
+
+const uint8_t *SerialFlashChip::image()
+{
+    init_flash();
+    return flash;
+}
+
+uint32_t SerialFlashFile::read(void *buf, uint32_t rdlen)
+{
+    if (offset + rdlen > length)
+    {
+        if (offset >= length)
+            return 0;
+        rdlen = length - offset;
+    }
+    SerialFlash.read(address + offset, buf, rdlen);
+    offset += rdlen;
+    return rdlen;
+}
+
+uint32_t SerialFlashFile::write(const void *buf, uint32_t wrlen)
+{
+    if (offset + wrlen > length)
+    {
+        if (offset >= length)
+            return 0;
+        wrlen = length - offset;
+    }
+    SerialFlash.write(address + offset, buf, wrlen);
+    offset += wrlen;
+    return wrlen;
+}
+
+void SerialFlashFile::erase()
+{
+    uint32_t block = SerialFlash.blockSize();
+    if (address % block != 0)
+        return; // only erasable files can be erased
+    for (uint32_t addr = address; addr < address + length; addr += block)
+        SerialFlash.eraseBlock(addr);
+}
@@ -0,0 +1,160 @@
+// Binary logging for loops where snprintf() and Serial.print() cost too much.
+
+/**
+ * binlog() puts a frame in a RAM ring buffer and returns; nothing is
+ * formatted on the device. Each frame is:
+ *
+ *   sync (0xB1), format ID, number of args, millis() (4 bytes), args (4 bytes each)
+ *
+ * with multi-byte values little-endian. binlog_drain() sends whole frames
+ * while Serial.availableForWrite() says they fit. Call it from loop() and
+ * use binlog_flush() after a batch of work. In the loops being logged, most
+ * binlog() calls only copy into the ring; once the ring passes
+ * BINLOG_HIGH_WATER, binlog_write() drains it so long loops don't lose
+ * messages. That is one burst of port I/O per few dozen messages instead
+ * of one per message. (The SAMD USB port always reports room, so there a
+ * drain waits for the host to read.)
+ * Because frames are never split, they can be mixed with the text written
+ * using Serial.print(); tools/binlog_decode.py separates the two and
+ * expands the frames using the formats in binlog_formats.h. The time and
+ * arguments can hold any byte, including the query frames' sync byte, so
+ * the decoders skip each other's frames by length (see flash_query.h).
+ *
+ * When the ring is full, messages are dropped and counted. The count is
+ * sent as one BINLOG_DROPPED message once there is room again: ahead of the
+ * next message if both fit, otherwise by binlog_drain() once it has sent
+ * everything in the ring.
+ */
+
+#include <Arduino.h>
+
+#include "binlog.h"
+
+#define Serial SerialUSB
+
+#define BINLOG_FRAME_HEADER_SIZE 7 // sync, format, nargs, time
+#define BINLOG_MAX_FRAME_SIZE (BINLOG_FRAME_HEADER_SIZE + BINLOG_MAX_ARGS * sizeof(uint32_t))
+#define BINLOG_DROPPED_FRAME_SIZE (BINLOG_FRAME_HEADER_SIZE + sizeof(uint32_t))
+
+static uint8_t ring[BINLOG_RING_SIZE];
+static uint16_t head = 0;  // next byte written goes here
+static uint16_t tail = 0;  // next byte sent comes from here
+static uint16_t count = 0; // bytes in the ring
+
+static uint32_t drops = 0;      // total messages dropped
+static uint32_t unreported = 0; // dropped since the last BINLOG_DROPPED message
+
+static void put_byte(const uint8_t b)
+{
+    ring[head] = b;
+    head = (head + 1) % BINLOG_RING_SIZE;
+}
+
+static void put_uint32(const uint32_t value)
+{
+    put_byte(value & 0xFF);
+    put_byte((value >> 8) & 0xFF);
+    put_byte((value >> 16) & 0xFF);
+    put_byte((value >> 24) & 0xFF);
+}
+
+static bool put_frame(const uint8_t format, const uint32_t *args, const uint8_t nargs)
+{
+    uint16_t len = BINLOG_FRAME_HEADER_SIZE + nargs * sizeof(uint32_t);
+    if (count + len > BINLOG_RING_SIZE)
+        return false;
+
+    put_byte(BINLOG_SYNC);
+    put_byte(format);
+    put_byte(nargs);
+    put_uint32(millis());
+    for (uint8_t i = 0; i < nargs; ++i)
+        put_uint32(args[i]);
+
+    count += len;
+    return true;
+}
+
+/**
+ * @brief Add a message to the ring buffer. Use binlog() instead of this.
+ * @param format One of the IDs in binlog_formats.h
+ * @param args The arguments
+ * @param nargs The number of arguments
+ */
+void binlog_write(const uint8_t format, const uint32_t *args, const uint8_t nargs)
+{
+    // Only report earlier drops here if this message fits after the report;
+    // otherwise binlog_drain() sends the count.
+    uint16_t len = BINLOG_FRAME_HEADER_SIZE + nargs * sizeof(uint32_t);
+    if (unreported > 0 && count + BINLOG_DROPPED_FRAME_SIZE + len <= BINLOG_RING_SIZE)
+    {
+        put_frame(BINLOG_DROPPED, &unreported, 1);
+        unreported = 0;
+    }
+
+    if (nargs > BINLOG_MAX_ARGS || !put_frame(format, args, nargs))
+    {
+        ++drops;
+        ++unreported;
+    }
+
+    if (count > BINLOG_HIGH_WATER)
+        binlog_drain();
+}
+
+static void send_frames()
+{
+    uint8_t frame[BINLOG_MAX_FRAME_SIZE];
+
+    while (count > 0)
+    {
+        uint16_t len = BINLOG_FRAME_HEADER_SIZE + ring[(tail + 2) % BINLOG_RING_SIZE] * sizeof(uint32_t);
+        if (Serial.availableForWrite() < len)
+            return;
+
+        for (uint16_t i = 0; i < len; ++i)
+            frame[i] = ring[(tail + i) % BINLOG_RING_SIZE];
+
+        Serial.write(frame, len);
+        tail = (tail + len) % BINLOG_RING_SIZE;
+        count -= len;
+    }
+}
+
+/**
+ * @brief Send as many whole frames as the serial port says it will take.
+ * Once the ring is empty, also send the count of any messages dropped since
+ * the last report.
+ */
+void binlog_drain()
+{
+    send_frames();
+
+    // Waiting for an empty ring keeps the report from taking the last bytes
+    // of a full one while the port is stalled.
+    if (count == 0 && unreported > 0 && put_frame(BINLOG_DROPPED, &unreported, 1))
+    {
+        unreported = 0;
+        send_frames();
+    }
+}
+
+/**
+ * @brief Send everything in the ring buffer, waiting for the serial port
+ */
+void binlog_flush()
+{
+    while (count > 0)
+    {
+        binlog_drain();
+        yield();
+    }
+}
+
+/**
+ * @return The total number of messages dropped because the ring was full.
+ */
+uint32_t binlog_drops()
+{
+    return drops;
+}
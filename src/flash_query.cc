@@ -0,0 +1,290 @@
+// Answer queries for ranges of records without dumping whole files.
+
+/**
+ * Each data file holds one month (the writers must keep records in the
+ * month of their file), so the header alone says whether a file can hold
+ * any records in the query's range; files of the wrong type or
+ * outside the range are skipped after reading their ten-byte header. The
+ * records in a file are in time order, so fixed-size records before the
+ * range are skipped with a binary search and reading a file stops at the
+ * first record past the end of the range. Records are read one at a time and only
+ * the selected fields of the selected records are sent. See flash_query.h
+ * for the command and the frames.
+ */
+
+#include <Arduino.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <SerialFlash.h>
+
+#include "flash_utils.h"
+#include "record_types.h"
+#include "flash_query.h"
+
+struct query
+{
+    uint16_t type;
+    uint32_t from;
+    uint32_t to;
+    uint32_t every;
+    uint8_t fields; // bit mask
+};
+
+static void put_uint16(uint8_t *buf, const uint16_t value)
+{
+    buf[0] = value & 0xFF;
+    buf[1] = (value >> 8) & 0xFF;
+}
+
+static void put_uint32(uint8_t *buf, const uint32_t value)
+{
+    put_uint16(buf, value & 0xFFFF);
+    put_uint16(buf + 2, value >> 16);
+}
+
+static void send_frame(Print &out, const uint8_t type, const uint8_t *payload, const uint16_t len)
+{
+    uint8_t header[4] = {QUERY_SYNC, type};
+    put_uint16(&header[2], len);
+
+    uint8_t checksum = 0;
+    for (uint16_t i = 0; i < len; ++i)
+        checksum ^= payload[i];
+
+    out.write(header, sizeof(header));
+    out.write(payload, len);
+    out.write(checksum);
+}
+
+static void send_end(Print &out, const uint32_t count, const query_status status)
+{
+    uint8_t payload[5];
+    put_uint32(payload, count);
+    payload[4] = status;
+    send_frame(out, QUERY_FRAME_END, payload, sizeof(payload));
+}
+
+static bool parse_number(const char *&p, uint32_t &value)
+{
+    char *end;
+    uint32_t n = strtoul(p, &end, 10);
+    if (end == p)
+        return false;
+
+    value = n;
+    p = end;
+    return true;
+}
+
+/**
+ * @brief Parse 'q <type> <from> <to> [every [fields]]'
+ * @return True if the command is a query, false otherwise.
+ */
+static bool parse_query(const char *command, query &q)
+{
+    if (command[0] != 'q')
+        return false;
+
+    const char *p = command + 1;
+    uint32_t type;
+    if (!parse_number(p, type) || !parse_number(p, q.from) || !parse_number(p, q.to))
+        return false;
+
+    q.type = type;
+    q.every = 1;
+    q.fields = 0;
+    if (parse_number(p, q.every))
+    {
+        uint32_t field;
+        while (parse_number(p, field))
+        {
+            if (field >= RECORD_FIELDS_MAX)
+                return false;
+            q.fields |= 1 << field;
+            if (*p == ',')
+                ++p;
+        }
+    }
+
+    while (*p == ' ')
+        ++p;
+
+    return *p == '\0' && q.every > 0;
+}
+
+/**
+ * @brief Find the first fixed-size record at or after 'from'
+ * The records are in time order, so this is a binary search that reads
+ * about log2(num_records) records instead of every one before 'from'.
+ * @return The index of the record, num_records if there is none, or -1 if
+ * a record could not be read.
+ */
+static int32_t first_record(SerialFlashFile &file, const record_type_info *info, const uint32_t from,
+                            const uint16_t num_records, const uint32_t file_start)
+{
+    char record[RECORD_MAX_SIZE];
+    uint16_t low = 0;
+    uint16_t high = num_records;
+    while (low < high)
+    {
+        uint16_t mid = low + (high - low) / 2;
+        file.seek(FLASH_FILE_HEADER_SIZE + (uint32_t)mid * info->size);
+        if (!read_record_from_file(file, record, info->size))
+            return -1;
+
+        if (info->time(record, info->size, mid, file_start) < from)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/**
+ * @brief Send the selected records from one file
+ * @return False if a record could not be read, true otherwise.
+ */
+static bool query_file(SerialFlashFile &file, const record_type_info *info, const query &q, const uint16_t num_records,
+                       const uint32_t file_start, uint32_t &matched, uint32_t &count, Print &out)
+{
+    char record[RECORD_MAX_SIZE];
+    uint8_t payload[sizeof(uint16_t) + sizeof(uint32_t) + RECORD_MAX_SIZE];
+
+    // Fixed-size records can be skipped to the first one in the range.
+    // Variable-length records are read from the start until RECORD_END;
+    // short records let more than num_records fit in the file.
+    uint16_t first = 0;
+    if (info->size != RECORD_SIZE_VARIABLE)
+    {
+        int32_t index = first_record(file, info, q.from, num_records, file_start);
+        if (index < 0)
+            return false;
+
+        first = index;
+        file.seek(FLASH_FILE_HEADER_SIZE + (uint32_t)first * info->size);
+    }
+
+    for (uint16_t i = first; info->size == RECORD_SIZE_VARIABLE || i < num_records; ++i)
+    {
+        uint16_t size = info->size;
+        if (info->size == RECORD_SIZE_VARIABLE)
+        {
+            record_status status = read_variable_record_from_file(file, record, sizeof(record), size);
+            if (status == RECORD_END)
+                return true;
+            if (status == RECORD_ERROR)
+                return false;
+        }
+        else if (!read_record_from_file(file, record, size))
+        {
+            return false;
+        }
+
+        uint32_t t = info->time(record, size, i, file_start);
+        if (t < q.from)
+            continue;
+        if (t > q.to)
+            return true;
+        if (matched++ % q.every != 0)
+            continue;
+
+        put_uint16(payload, i);
+        put_uint32(payload + 2, t);
+        uint16_t len = 6;
+        for (uint8_t f = 0; f < info->num_fields; ++f)
+        {
+            if (q.fields && !(q.fields & (1 << f)))
+                continue;
+
+            const record_field &field = info->fields[f];
+            if (field.offset >= size)
+                continue;
+            uint16_t field_size = field.size == 0 || field.offset + field.size > size ? size - field.offset : field.size;
+            if (len + field_size > sizeof(payload))
+                break;
+            memcpy(payload + len, record + field.offset, field_size);
+            len += field_size;
+        }
+
+        send_frame(out, QUERY_FRAME_RECORD, payload, len);
+        ++count;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Answer a command that could not be read, e.g. one longer than
+ * QUERY_COMMAND_SIZE, with an END frame and QUERY_BAD_COMMAND
+ * @param out Where to send the frame
+ */
+void reject_query(Print &out)
+{
+    send_end(out, 0, QUERY_BAD_COMMAND);
+}
+
+/**
+ * @brief Run one query and send the results
+ * @param command The query; see flash_query.h
+ * @param out Where to send the frames
+ * @return True if the query ran, false if the command was not understood or
+ * a read failed. An END frame is sent either way.
+ */
+bool run_query(const char *command, Print &out)
+{
+    query q;
+    if (!parse_query(command, q))
+    {
+        send_end(out, 0, QUERY_BAD_COMMAND);
+        return false;
+    }
+
+    const record_type_info *info = find_record_type(q.type);
+    if (!info || !info->time)
+    {
+        send_end(out, 0, QUERY_UNKNOWN_TYPE);
+        return false;
+    }
+
+    uint32_t matched = 0;
+    uint32_t count = 0;
+    char filename[64];
+    uint32_t filesize;
+
+    SerialFlash.opendir();
+    while (SerialFlash.readdir(filename, sizeof(filename), filesize))
+    {
+        SerialFlashFile file = SerialFlash.open(filename);
+        uint16_t year, month, num_records, record_size, record_type;
+        if (!read_header_from_file(file, year, month, num_records, record_size, record_type))
+            continue; // not a data file
+
+        if (record_type != q.type || month < 1 || month > 12)
+            continue;
+        if (info->size != RECORD_SIZE_VARIABLE && info->size != record_size)
+            continue;
+
+        uint32_t file_start = month_start_time(month, year);
+        uint32_t file_end = file_start + days_per_month(month, year) * 86400UL - 1;
+        if (file_end < q.from || file_start > q.to)
+            continue;
+
+        uint8_t payload[6];
+        put_uint16(payload, year);
+        put_uint16(payload + 2, month);
+        put_uint16(payload + 4, num_records);
+        send_frame(out, QUERY_FRAME_FILE, payload, sizeof(payload));
+
+        if (!query_file(file, info, q, num_records, file_start, matched, count, out))
+        {
+            send_end(out, count, QUERY_READ_ERROR);
+            return false;
+        }
+    }
+
+    send_end(out, count, QUERY_OK);
+    return true;
+}
@@ -0,0 +1,162 @@
+// Counters and a trace of recent operations for the flash utilities.
+
+/**
+ * Everything here is compiled only when FLASH_STATS is non-zero. Updating
+ * the counters is a few adds and one micros() call per operation, and the
+ * trace is a fixed ring of FLASH_TRACE_SIZE entries, so this can be left
+ * on in the field. Send 's' on the serial port for the counters, 't' for
+ * the trace and 'z' to zero both (see flash_stats_command()).
+ */
+
+#include <Arduino.h>
+
+#include <string.h>
+
+#include "flash_utils.h"
+#include "flash_stats.h"
+
+#if FLASH_STATS
+
+#define Serial SerialUSB
+
+flash_stats flash_counters;
+
+static flash_trace_entry trace[FLASH_TRACE_SIZE];
+static uint16_t trace_next = 0;   // next entry to write
+static uint32_t trace_total = 0; // entries written since the last reset
+
+static const char *op_names[FLASH_OP_COUNT] = {
+    "space_on_flash",
+    "erase_flash",
+    "setup_spi_flash",
+    "make_new_data_file",
+    "write_header",
+    "write_record",
+    "read_header",
+    "read_record",
+};
+
+void flash_stats_reset()
+{
+    memset(&flash_counters, 0, sizeof(flash_counters));
+    memset(trace, 0, sizeof(trace));
+    trace_next = 0;
+    trace_total = 0;
+}
+
+/**
+ * @brief Add an entry to the trace ring buffer
+ * @param op The operation
+ * @param start_us When it started, from micros()
+ * @param status True if the operation worked
+ * @param arg Bytes moved or bytes erased
+ */
+void flash_trace_add(const flash_op op, const uint32_t start_us, const bool status, const uint32_t arg)
+{
+    uint32_t duration = micros() - start_us;
+
+    flash_trace_entry &e = trace[trace_next];
+    e.start_us = start_us;
+    e.duration_us = duration > 0xFFFF ? 0xFFFF : duration;
+    e.op = op;
+    e.status = status;
+    e.arg = arg;
+
+    trace_next = (trace_next + 1) % FLASH_TRACE_SIZE;
+    ++trace_total;
+}
+
+/**
+ * @brief Count one read or write on the SPI bus
+ * A write is counted as one page program for each flash page it touches.
+ * @param write True for a write, false for a read
+ * @param address The flash address of the first byte
+ * @param len The number of bytes
+ */
+void flash_stats_count_transfer(const bool write, const uint32_t address, const uint32_t len)
+{
+    ++flash_counters.spi_transactions;
+    if (!write)
+    {
+        flash_counters.bytes_read += len;
+        return;
+    }
+
+    flash_counters.bytes_written += len;
+    if (len > 0)
+        flash_counters.page_programs += (address + len - 1) / FLASH_PAGE_SIZE - address / FLASH_PAGE_SIZE + 1;
+}
+
+/**
+ * @brief Print the counters on the serial port
+ */
+void flash_stats_dump()
+{
+    char msg[128];
+
+    snprintf(msg, sizeof(msg), "Flash stats: read %lu bytes, wrote %lu bytes, %lu SPI transactions",
+             (unsigned long)flash_counters.bytes_read, (unsigned long)flash_counters.bytes_written,
+             (unsigned long)flash_counters.spi_transactions);
+    Serial.println(msg);
+    snprintf(msg, sizeof(msg), "  page programs: %lu, erases: %lu, busy wait: %lu us",
+             (unsigned long)flash_counters.page_programs, (unsigned long)flash_counters.erases,
+             (unsigned long)flash_counters.busy_wait_us);
+    Serial.println(msg);
+
+    for (int i = 0; i < FLASH_OP_COUNT; ++i)
+    {
+        const flash_op_stats &s = flash_counters.ops[i];
+        if (s.calls == 0)
+            continue;
+
+        snprintf(msg, sizeof(msg), "  %20s: %lu calls, %lu us total, %lu us max", op_names[i],
+                 (unsigned long)s.calls, (unsigned long)s.total_us, (unsigned long)s.max_us);
+        Serial.println(msg);
+    }
+}
+
+/**
+ * @brief Print the trace, oldest entry first
+ */
+void flash_trace_dump()
+{
+    char msg[128];
+    uint32_t n = trace_total < FLASH_TRACE_SIZE ? trace_total : FLASH_TRACE_SIZE;
+    uint16_t first = (trace_next + FLASH_TRACE_SIZE - n) % FLASH_TRACE_SIZE;
+
+    snprintf(msg, sizeof(msg), "Flash trace: %lu of %lu entries", (unsigned long)n, (unsigned long)trace_total);
+    Serial.println(msg);
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const flash_trace_entry &e = trace[(first + i) % FLASH_TRACE_SIZE];
+        snprintf(msg, sizeof(msg), "  %10lu us %20s %5u us %s arg %lu", (unsigned long)e.start_us, op_names[e.op],
+                 e.duration_us, e.status ? "ok  " : "FAIL", (unsigned long)e.arg);
+        Serial.println(msg);
+    }
+}
+
+/**
+ * @brief Handle a one-character stats command from the serial port
+ * @param c The character read
+ * @return True if 'c' was a stats command, false otherwise.
+ */
+bool flash_stats_command(const int c)
+{
+    switch (c)
+    {
+    case 's':
+        flash_stats_dump();
+        return true;
+    case 't':
+        flash_trace_dump();
+        return true;
+    case 'z':
+        flash_stats_reset();
+        return true;
+    default:
+        return false;
+    }
+}
+
+#endif
@@ -0,0 +1,264 @@
+// Write several data files at once, one per sensor.
+
+/**
+ * Each stream is one data file (made by make_new_data_file() and with the
+ * usual header) and a small RAM ring buffer. Sensors push whole records
+ * into the ring at their own rate and record size; pushing only copies
+ * bytes, so the time it takes does not depend on how many streams are open
+ * or whether the flash chip is busy. If a ring is full, the record is
+ * dropped and counted.
+ *
+ * service_flash_streams() is called from loop(). Each call issues at most
+ * one page program, taking the streams in round-robin order so a fast
+ * sensor cannot starve a slow one. A stream is only written once it holds
+ * enough data to fill the rest of the current flash page, so every program
+ * after the first (which follows the header) is a full, page-aligned 256
+ * bytes. SerialFlash aligns every file to a page boundary, which is what
+ * makes the page arithmetic below work.
+ */
+
+#include <Arduino.h>
+
+#include <string.h>
+
+#include <SerialFlash.h>
+
+#include "flash_utils.h"
+#include "flash_streams.h"
+
+#define Serial SerialUSB
+
+struct flash_stream
+{
+    SerialFlashFile file;
+    uint8_t buffer[FLASH_STREAM_BUFFER_SIZE];
+    uint16_t head;           // next byte pushed goes here
+    uint16_t tail;           // next byte written to flash comes from here
+    volatile uint16_t count; // bytes in the ring
+    uint16_t record_size;
+    volatile uint32_t file_space; // bytes left in the file, less those already in the ring
+    volatile uint32_t drops;
+    bool open;
+};
+
+static flash_stream streams[FLASH_MAX_STREAMS];
+static int next_stream = 0; // round-robin position for service_flash_streams()
+
+static bool valid_stream(const int stream)
+{
+    return stream >= 0 && stream < FLASH_MAX_STREAMS && streams[stream].open;
+}
+
+/**
+ * @brief The number of bytes needed to reach the next page boundary
+ * @param s The stream
+ * @return Between 1 and FLASH_PAGE_SIZE.
+ */
+static uint32_t bytes_to_page_end(flash_stream &s)
+{
+    uint32_t address = s.file.getFlashAddress() + s.file.position();
+    return FLASH_PAGE_SIZE - (address % FLASH_PAGE_SIZE);
+}
+
+/**
+ * @brief Write the oldest 'len' bytes in the stream's ring to flash.
+ * @param s The stream
+ * @param len Number of bytes; must not cross a flash page.
+ * @return True if the write worked, false otherwise.
+ */
+static bool write_stream_bytes(flash_stream &s, const uint32_t len)
+{
+    static uint8_t page[FLASH_PAGE_SIZE];
+
+    // The ring may wrap; copy into one contiguous page so it's a single program.
+    uint32_t first = FLASH_STREAM_BUFFER_SIZE - s.tail;
+    if (first > len)
+        first = len;
+    memcpy(page, &s.buffer[s.tail], first);
+    memcpy(page + first, &s.buffer[0], len - first);
+
+    bool status = write_record_to_file(s.file, (const char *)page, len);
+
+    uint32_t primask = __get_PRIMASK();
+    noInterrupts();
+    s.tail = (s.tail + len) % FLASH_STREAM_BUFFER_SIZE;
+    s.count -= len;
+    __set_PRIMASK(primask);
+
+    return status;
+}
+
+/**
+ * @brief Make a new data file and open a stream to write records to it.
+ *
+ * The file is made large enough for 'num_records' records and the header is
+ * written before this returns.
+ *
+ * @param filename The name of the new file
+ * @param year Header info
+ * @param month Header info
+ * @param num_records The number of records the file can hold
+ * @param record_size The number of bytes in each record
+ * @param record_type An identifier for the type of the record.
+ * @return The stream number, or -1 if there is no free stream or the file
+ * could not be made.
+ */
+int open_flash_stream(const char *filename, const uint16_t year, const uint16_t month,
+                      const uint16_t num_records, const uint16_t record_size, const uint16_t record_type)
+{
+    if (record_size == 0 || record_size > FLASH_STREAM_BUFFER_SIZE)
+        return -1;
+
+    int stream = 0;
+    while (stream < FLASH_MAX_STREAMS && streams[stream].open)
+        ++stream;
+    if (stream == FLASH_MAX_STREAMS)
+    {
+        Serial.println("No free flash streams.");
+        return -1;
+    }
+
+    flash_stream &s = streams[stream];
+    if (!make_new_data_file(s.file, filename, num_records, record_size))
+        return -1;
+
+    if (!write_header_to_file(s.file, year, month, num_records, record_size, record_type))
+    {
+        Serial.println("Could not write the data file header.");
+        return -1;
+    }
+
+    s.head = 0;
+    s.tail = 0;
+    s.count = 0;
+    s.record_size = record_size;
+    s.file_space = (uint32_t)num_records * record_size;
+    s.drops = 0;
+    s.open = true;
+
+    return stream;
+}
+
+/**
+ * @brief Add a record to a stream.
+ *
+ * This does not touch the flash chip and is safe to call from an interrupt
+ * handler. If the stream's buffer or its file is full, the record is
+ * dropped.
+ *
+ * @param stream The stream number from open_flash_stream()
+ * @param record The record; must be the stream's record_size bytes.
+ * @return True if the record was queued, false if it was dropped.
+ */
+bool push_stream_record(const int stream, const char *record)
+{
+    if (!valid_stream(stream))
+        return false;
+
+    flash_stream &s = streams[stream];
+    if (s.count + s.record_size > FLASH_STREAM_BUFFER_SIZE || s.record_size > s.file_space)
+    {
+        ++s.drops;
+        return false;
+    }
+
+    uint32_t first = FLASH_STREAM_BUFFER_SIZE - s.head;
+    if (first > s.record_size)
+        first = s.record_size;
+    memcpy(&s.buffer[s.head], record, first);
+    memcpy(&s.buffer[0], record + first, s.record_size - first);
+
+    s.head = (s.head + s.record_size) % FLASH_STREAM_BUFFER_SIZE;
+    // Restore the caller's interrupt state instead of enabling interrupts,
+    // which would let other handlers nest inside the caller's handler.
+    uint32_t primask = __get_PRIMASK();
+    noInterrupts();
+    s.file_space -= s.record_size;
+    s.count += s.record_size;
+    __set_PRIMASK(primask);
+
+    return true;
+}
+
+/**
+ * @brief Write at most one page of buffered data to the flash chip.
+ *
+ * Call this from loop(). It returns without blocking if the chip is still
+ * busy with the previous program.
+ *
+ * @return True if a page was written, false if there was nothing to do,
+ * the chip was busy or the write failed.
+ */
+bool service_flash_streams()
+{
+    if (!SerialFlash.ready())
+        return false;
+
+    for (int i = 0; i < FLASH_MAX_STREAMS; ++i)
+    {
+        int stream = (next_stream + i) % FLASH_MAX_STREAMS;
+        flash_stream &s = streams[stream];
+        if (!s.open)
+            continue;
+
+        uint32_t len = bytes_to_page_end(s);
+        if (s.count < len)
+            continue;
+
+        next_stream = (stream + 1) % FLASH_MAX_STREAMS;
+        return write_stream_bytes(s, len);
+    }
+
+    return false;
+}
+
+/**
+ * @brief Write whatever is left in the stream's buffer and close it.
+ *
+ * This waits for the flash chip, so don't call it while sampling.
+ *
+ * @param stream The stream number from open_flash_stream()
+ * @return True if the buffered data was written, false otherwise.
+ */
+bool close_flash_stream(const int stream)
+{
+    if (!valid_stream(stream))
+        return false;
+
+    flash_stream &s = streams[stream];
+    bool status = true;
+    while (status && s.count > 0)
+    {
+        uint32_t len = bytes_to_page_end(s);
+        if (len > s.count)
+            len = s.count;
+        status = write_stream_bytes(s, len);
+    }
+
+    s.file.close();
+    s.open = false;
+
+    return status;
+}
+
+/**
+ * @return The number of bytes waiting to be written to flash for the stream.
+ */
+uint32_t stream_backlog(const int stream)
+{
+    if (!valid_stream(stream))
+        return 0;
+
+    return streams[stream].count;
+}
+
+/**
+ * @return The number of records dropped by the stream because it was full.
+ */
+uint32_t stream_drops(const int stream)
+{
+    if (!valid_stream(stream))
+        return 0;
+
+    return streams[stream].drops;
+}
@@ -9,7 +9,9 @@
  * data files for the HAST leaf node. The files each hold one month's data.
  * Each file has a 6-byte header that holds the year (2 digits), the month
  * and the number of records. Each record contains a time stamp and various
- * data values. The size of each record must be the same.
+ * data values. The size of each record must be the same, unless the record
+ * type is variable-length, in which case each record is prefixed by its
+ * length (see record_types.h).
  */
 
 #include <Arduino.h>
@@ -22,6 +24,8 @@
 #include <SerialFlash.h>
 
 #include "flash_utils.h"
+#include "binlog.h"
+#include "flash_stats.h"
 
 #define STATUS_LED 13
 #define Serial SerialUSB // Needed for RS. jhrg 7/26/20
@@ -52,26 +56,28 @@ static void stop()
  */
 uint32_t space_on_flash(bool verbose)
 {
+    FLASH_STATS_TIMER(FLASH_OP_SPACE_ON_FLASH);
     uint8_t buf[16];
-    char msg[256];
 
     Serial.println(F("Read Chip Identification:"));
 
     SerialFlash.readID(buf);
-    snprintf(msg, 255, "  JEDEC ID:     %02X %02X %0X", buf[0], buf[1], buf[2]);
-    Serial.println(msg);
+    binlog(BINLOG_JEDEC_ID, buf[0], buf[1], buf[2]);
 
     uint32_t chipsize = SerialFlash.capacity(buf);
-    snprintf(msg, 255, "  Memory Size:  %ld", chipsize);
-    Serial.println(msg);
+    binlog(BINLOG_MEMORY_SIZE, chipsize);
 
     if (chipsize == 0)
+    {
+        FLASH_STATS_RESULT(false, 0);
         return 0;
+    }
 
     uint32_t blocksize = SerialFlash.blockSize();
-    snprintf(msg, 255, "  Block Size:   %ld", blocksize);
-    Serial.println(msg);
+    binlog(BINLOG_BLOCK_SIZE, blocksize);
+    binlog_drain();
 
+    FLASH_STATS_RESULT(true, chipsize);
     return chipsize;
 }
 
@@ -82,18 +88,26 @@ uint32_t space_on_flash(bool verbose)
  */
 void erase_flash()
 {
+    FLASH_STATS_TIMER(FLASH_OP_ERASE_FLASH);
+
     // We start by formatting the flash...
     uint8_t id[5];
     SerialFlash.readID(id);
     SerialFlash.eraseAll();
+    FLASH_STATS_ADD(erases, 1);
+    FLASH_STATS_RESULT(true, SerialFlash.capacity(id));
 
     bool status_value = digitalRead(STATUS_LED); // record state
 
+#if FLASH_STATS
+    uint32_t wait_start = micros();
+#endif
     while (SerialFlash.ready() == false)
     {
         delay(HALF_SEC);
         digitalWrite(STATUS_LED, !digitalRead(STATUS_LED));
     }
+    FLASH_STATS_ADD(busy_wait_us, micros() - wait_start);
 
 #if JLINK == 0 // The debugger blocks the interupt handler for millis() and micros()
     // Quickly flash LED a few times when completed, then leave the light on solid
@@ -121,6 +135,7 @@ void erase_flash()
  */
 uint32_t setup_spi_flash(bool erase, bool verbose)
 {
+    FLASH_STATS_TIMER(FLASH_OP_SETUP_SPI_FLASH);
     bool status = SerialFlash.begin(SPI, FLASH_CS);
     if (!status)
     {
@@ -151,7 +166,7 @@ uint32_t setup_spi_flash(bool erase, bool verbose)
 
 // Use ones-indexing for the number of days
 // TODO Leap years... jhrg 2/21/22
-static bool is_leap(uint16_t year)
+bool is_leap(uint16_t year)
 {
     return ((year % 4) == 0 && (year % 100) != 0) || (year % 400) == 0;
 }
@@ -199,6 +214,9 @@ char *make_data_file_name(const int month, const int yy)
  */
 bool make_new_data_file(SerialFlashFile &flashFile, const char *filename, const int size_of_file)
 {
+    FLASH_STATS_TIMER(FLASH_OP_MAKE_NEW_DATA_FILE);
+    FLASH_STATS_RESULT(false, size_of_file);
+
     if (SerialFlash.exists(filename))
     {
         Serial.print("The file already exists: ");
@@ -216,6 +234,7 @@ bool make_new_data_file(SerialFlashFile &flashFile, const char *filename, const
 
     flashFile = SerialFlash.open(filename);
 
+    FLASH_STATS_RESULT(flashFile ? true : false, size_of_file);
     return flashFile ? true : false;
 }
 
@@ -224,8 +243,44 @@ bool make_new_data_file(SerialFlashFile &flashFile, const char *filename, const
     return make_new_data_file(flashFile, filename, FLASH_FILE_HEADER_SIZE + (num_records * record_size));
 }
 
+/**
+ * @brief Make a file for variable-length records
+ * Each record takes its length (a uint16_t) plus its data, so the file is
+ * FLASH_FILE_HEADER_SIZE + num_records * (2 + max_record_size) bytes.
+ * @param flashFile Value-result param for the new file, open.
+ * @param filename The name of the new file
+ * @param num_records The most records the file can hold
+ * @param max_record_size The size of the largest record
+ * @return True if the file was made, false otherwise.
+ */
+bool make_new_variable_data_file(SerialFlashFile &flashFile, const char *filename, const int num_records,
+                                 const int max_record_size)
+{
+    return make_new_data_file(flashFile, filename, num_records, sizeof(uint16_t) + max_record_size);
+}
+
+/**
+ * @brief With FLASH_STATS, wait for the chip to finish its last program or
+ * erase and count the time in busy_wait_us.
+ * SerialFlash waits for this on its own before each write, so waiting here
+ * first only moves the wait to where it can be timed. Reads don't call
+ * this since SerialFlash can read without waiting for an erase. Without
+ * FLASH_STATS this does nothing.
+ */
+static void wait_for_flash()
+{
+#if FLASH_STATS
+    uint32_t wait_start = micros();
+    while (!SerialFlash.ready())
+        ;
+    FLASH_STATS_ADD(busy_wait_us, micros() - wait_start);
+#endif
+}
+
 static bool write_uint16(SerialFlashFile &flashFile, const uint16_t value)
 {
+    wait_for_flash();
+    FLASH_STATS_TRANSFER(true, flashFile.getFlashAddress() + flashFile.position(), sizeof(uint16_t));
     uint32_t len = flashFile.write(&value, sizeof(uint16_t));
     if (len != sizeof(uint16_t))
     {
@@ -249,12 +304,16 @@ static bool write_uint16(SerialFlashFile &flashFile, const uint16_t value)
 bool write_header_to_file(SerialFlashFile &flashFile, const uint16_t year, const uint16_t month,
                           const uint16_t num_records, const uint16_t record_size, const uint16_t record_type)
 {
+    FLASH_STATS_TIMER(FLASH_OP_WRITE_HEADER);
     if (!flashFile)
     {
+        FLASH_STATS_RESULT(false, 0);
         return false;
     }
 
-    return write_uint16(flashFile, year) && write_uint16(flashFile, month) && write_uint16(flashFile, num_records) && write_uint16(flashFile, record_size) && write_uint16(flashFile, record_type);
+    bool status = write_uint16(flashFile, year) && write_uint16(flashFile, month) && write_uint16(flashFile, num_records) && write_uint16(flashFile, record_size) && write_uint16(flashFile, record_type);
+    FLASH_STATS_RESULT(status, FLASH_FILE_HEADER_SIZE);
+    return status;
 }
 
 /**
@@ -268,22 +327,28 @@ bool write_header_to_file(SerialFlashFile &flashFile, const uint16_t year, const
  */
 bool write_record_to_file(SerialFlashFile &flashFile, const char *record, const uint32_t record_size)
 {
+    FLASH_STATS_TIMER(FLASH_OP_WRITE_RECORD);
+    FLASH_STATS_RESULT(false, record_size);
     if (!flashFile)
     {
         return false;
     }
 
+    wait_for_flash();
+    FLASH_STATS_TRANSFER(true, flashFile.getFlashAddress() + flashFile.position(), record_size);
     uint32_t len = flashFile.write(record, record_size);
     if (len != record_size)
     {
         return false;
     }
 
+    FLASH_STATS_RESULT(true, record_size);
     return true;
 }
 
 static bool read_uint16(SerialFlashFile &flashFile, uint16_t &value)
 {
+    FLASH_STATS_TRANSFER(false, flashFile.getFlashAddress() + flashFile.position(), sizeof(uint16_t));
     uint32_t len = flashFile.read(&value, sizeof(uint16_t));
     if (len != sizeof(uint16_t))
     {
@@ -300,12 +365,16 @@ static bool read_uint16(SerialFlashFile &flashFile, uint16_t &value)
 bool read_header_from_file(SerialFlashFile &flashFile, uint16_t &year, uint16_t &month, uint16_t &num_records,
                            uint16_t &record_size, uint16_t &record_type)
 {
+    FLASH_STATS_TIMER(FLASH_OP_READ_HEADER);
     if (!flashFile)
     {
+        FLASH_STATS_RESULT(false, 0);
         return false;
     }
 
-    return read_uint16(flashFile, year) && read_uint16(flashFile, month) && read_uint16(flashFile, num_records) && read_uint16(flashFile, record_size) && read_uint16(flashFile, record_type);
+    bool status = read_uint16(flashFile, year) && read_uint16(flashFile, month) && read_uint16(flashFile, num_records) && read_uint16(flashFile, record_size) && read_uint16(flashFile, record_type);
+    FLASH_STATS_RESULT(status, FLASH_FILE_HEADER_SIZE);
+    return status;
 }
 
 /**
@@ -321,16 +390,92 @@ bool read_header_from_file(SerialFlashFile &flashFile, uint16_t &year, uint16_t
  */
 bool read_record_from_file(SerialFlashFile &flashFile, char *record, const uint32_t record_size)
 {
+    FLASH_STATS_TIMER(FLASH_OP_READ_RECORD);
+    FLASH_STATS_RESULT(false, record_size);
     if (!flashFile)
     {
         return false;
     }
 
+    FLASH_STATS_TRANSFER(false, flashFile.getFlashAddress() + flashFile.position(), record_size);
     uint32_t len = flashFile.read(record, record_size);
     if (len != record_size)
     {
         return false;
     }
 
+    FLASH_STATS_RESULT(true, record_size);
     return true;
 }
+
+
+/**
+ * @brief Write a variable-length record to the flash file.
+ *
+ * The record is written as a two-byte length followed by the data, so
+ * event-style records don't have to be padded to a worst-case size. The
+ * length 0xFFFF is what erased flash reads as and marks the end of the
+ * records in a file. Records larger than RECORD_MAX_SIZE are refused since
+ * no reader could buffer them, and so are records that don't fit in the
+ * rest of the file, so a full file never ends with part of a record.
+ *
+ * @param flashFile The open file.
+ * @param record A pointer to the record.
+ * @param record_size The number of bytes in the record.
+ * @return True if all the operations worked, false otherwise.
+ */
+bool write_variable_record_to_file(SerialFlashFile &flashFile, const char *record, const uint16_t record_size)
+{
+    if (!flashFile || record_size > RECORD_MAX_SIZE || flashFile.available() < sizeof(uint16_t) + record_size)
+    {
+        return false;
+    }
+
+    return write_uint16(flashFile, record_size) && write_record_to_file(flashFile, record, record_size);
+}
+
+/**
+ * @brief Read a variable-length record from the file.
+ *
+ * @param flashFile The open file.
+ * @param record Value-result param that holds the data just read.
+ * @param max_size The size of the 'record' buffer.
+ * @param record_size Value-result param that holds the number of bytes read.
+ * @return RECORD_OK if a record was read, RECORD_END if there are no more
+ * records (an erased length or the end of the file) and RECORD_ERROR if the record was too large for the buffer or
+ * could not be read. After an error, the rest of the file cannot be read
+ * since the next record's position is unknown.
+ */
+record_status read_variable_record_from_file(SerialFlashFile &flashFile, char *record, const uint16_t max_size,
+                                             uint16_t &record_size)
+{
+    record_size = 0;
+    if (!flashFile)
+    {
+        return RECORD_ERROR;
+    }
+
+    if (flashFile.available() < sizeof(uint16_t))
+    {
+        return RECORD_END;
+    }
+
+    uint16_t size;
+    if (!read_uint16(flashFile, size))
+    {
+        return RECORD_ERROR;
+    }
+
+    if (size == 0xFFFF)
+    {
+        return RECORD_END;
+    }
+
+    if (size > max_size || !read_record_from_file(flashFile, record, size))
+    {
+        return RECORD_ERROR;
+    }
+
+    record_size = size;
+    return RECORD_OK;
+}
@@ -0,0 +1,333 @@
+/**
+ * Build a flash chip image on the host, and optionally program it onto a
+ * board. The data files are made with the same flash_utils code the board
+ * uses, running against the host SerialFlash in lib/host_flash, so the
+ * image is byte-for-byte what write_data_to_flash.cc would leave on the
+ * chip.
+ *
+ *   make_flash_image [-p profile] [-y first] [-Y last] [-s seed] [-o image]
+ *   make_flash_image -i image -l
+ *   make_flash_image [-i image] -d /dev/cu.usbmodem112101
+ *
+ * Profiles:
+ *   test    The RECORD_TYPE_01 test records of write_data_to_flash.cc
+ *   events  RECORD_TYPE_02 variable-length events at random times
+ *   empty   Headers only; the records are left erased
+ */
+
+#include <Arduino.h>
+
+#include <SerialFlash.h>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "flash_utils.h"
+#include "flash_image.h"
+
+#define SAMPLES_PER_DAY 24
+#define MAX_EVENTS_PER_MONTH 200
+#define MAX_EVENT_SIZE 32 // bytes, including the four-byte time
+
+// Seconds to wait for the board to answer. A W25Q16 chip erase can take
+// 25 seconds and erase_flash() blinks the LED for two more after it.
+#define ERASE_TIMEOUT 40
+#define COMMAND_TIMEOUT 5
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-p test|events|empty] [-y first_year] [-Y last_year] [-s seed]\n"
+                    "       [-o image] [-i image] [-l] [-d device]\n"
+                    "Years are two digits. With -i, the image is loaded instead of built.\n"
+                    "-l lists the files in the image, -d programs the image onto a board.\n",
+            name);
+}
+
+/**
+ * @brief Make the test records, as write_test_data() does on the board
+ */
+static bool write_test_file(SerialFlashFile &file, const int month, const int year, const bool records)
+{
+    char record[11];
+    const int num_records = days_per_month(month, year) * SAMPLES_PER_DAY;
+    if (!make_new_data_file(file, make_data_file_name(month, year), num_records, sizeof(record)))
+        return false;
+
+    if (!write_header_to_file(file, year, month, num_records, sizeof(record), RECORD_TYPE_01))
+        return false;
+
+    for (uint16_t message = 1; records && message <= num_records; ++message)
+    {
+        // first two bytes are the message num. filler after that.
+        memcpy(record, &message, sizeof(message));
+        memset(&record[sizeof(message)], 0xAA, sizeof(record) - sizeof(message));
+        if (!write_record_to_file(file, record, sizeof(record)))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Make a month of events at random times with random amounts of data
+ */
+static bool write_events_file(SerialFlashFile &file, const int month, const int year, const bool records)
+{
+    if (!make_new_variable_data_file(file, make_data_file_name(month, year), MAX_EVENTS_PER_MONTH, MAX_EVENT_SIZE))
+        return false;
+
+    if (!write_header_to_file(file, year, month, MAX_EVENTS_PER_MONTH, MAX_EVENT_SIZE, RECORD_TYPE_02))
+        return false;
+
+    struct tm tm = {};
+    tm.tm_year = year + 100;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = 1;
+    uint32_t event_time = timegm(&tm);
+    const uint32_t seconds_per_month = days_per_month(month, year) * 86400;
+    const int num_events = records ? rand() % MAX_EVENTS_PER_MONTH : 0;
+
+    const uint32_t month_end = event_time + seconds_per_month;
+
+    for (int i = 0; i < num_events; ++i)
+    {
+        // Events stay in the month of their file.
+        event_time += rand() % (2 * seconds_per_month / MAX_EVENTS_PER_MONTH);
+        if (event_time >= month_end)
+            break;
+
+        char record[MAX_EVENT_SIZE];
+        const uint16_t len = sizeof(event_time) + rand() % (MAX_EVENT_SIZE - sizeof(event_time) + 1);
+        memcpy(record, &event_time, sizeof(event_time));
+        for (uint16_t j = sizeof(event_time); j < len; ++j)
+            record[j] = rand();
+
+        if (!write_variable_record_to_file(file, record, len))
+            return false;
+    }
+
+    return true;
+}
+
+static bool build_image(const char *profile, const int first_year, const int last_year)
+{
+    for (int year = first_year; year <= last_year; ++year)
+    {
+        for (int month = 1; month < 13; ++month)
+        {
+            SerialFlashFile file;
+            bool status;
+            if (strcmp(profile, "test") == 0)
+                status = write_test_file(file, month, year, true);
+            else if (strcmp(profile, "events") == 0)
+                status = write_events_file(file, month, year, true);
+            else if (strcmp(profile, "empty") == 0)
+                status = write_test_file(file, month, year, false);
+            else
+            {
+                fprintf(stderr, "Unknown profile: %s\n", profile);
+                return false;
+            }
+
+            if (!status)
+            {
+                fprintf(stderr, "Could not write %s (is the chip full?)\n", make_data_file_name(month, year));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void list_image()
+{
+    char filename[64];
+    uint32_t filesize;
+
+    SerialFlash.opendir();
+    while (SerialFlash.readdir(filename, sizeof(filename), filesize))
+    {
+        SerialFlashFile file = SerialFlash.open(filename);
+        uint16_t year = 0, month = 0, num_records = 0, record_size = 0, record_type = 0;
+        read_header_from_file(file, year, month, num_records, record_size, record_type);
+        printf("%20s: %7u bytes at 0x%06x, year %d, month %d, %d records of %d bytes, type %02x\n", filename,
+               filesize, file.getFlashAddress(), year, month, num_records, record_size, record_type);
+    }
+}
+
+/**
+ * @brief Wait for the board to answer a command, skipping anything else it sends
+ * @param fd The serial port
+ * @param timeout Seconds to wait for the answer
+ * @return True for FLASH_IMAGE_ACK, false for FLASH_IMAGE_NAK or a timeout.
+ */
+static bool wait_for_ack(const int fd, const int timeout)
+{
+    const time_t deadline = time(nullptr) + timeout;
+    while (time(nullptr) <= deadline)
+    {
+        uint8_t c;
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0)
+            return false;
+        if (n == 0)
+            continue; // the port's read timeout; keep waiting until the deadline
+
+        if (c == FLASH_IMAGE_ACK)
+            return true;
+        if (c == FLASH_IMAGE_NAK)
+            return false;
+    }
+
+    return false;
+}
+
+static bool send_command(const int fd, const uint8_t command, const void *data = nullptr, const size_t len = 0,
+                         const int timeout = COMMAND_TIMEOUT)
+{
+    return write(fd, &command, 1) == 1 && (len == 0 || write(fd, data, len) == (ssize_t)len) &&
+           wait_for_ack(fd, timeout);
+}
+
+/**
+ * @brief Program the image onto a board running load_flash_image.cc
+ */
+static bool flash_board(const char *device)
+{
+    int fd = open(device, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(device);
+        return false;
+    }
+
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 10; // tenths of a second; wait_for_ack() has the real timeouts
+    tcsetattr(fd, TCSANOW, &tio);
+
+    // Drop whatever the board printed when it started
+    sleep(1);
+    tcflush(fd, TCIFLUSH);
+
+    fprintf(stderr, "Erasing the flash chip...\n");
+    if (!send_command(fd, FLASH_IMAGE_ERASE, nullptr, 0, ERASE_TIMEOUT))
+    {
+        fprintf(stderr, "The board did not erase the chip.\n");
+        close(fd);
+        return false;
+    }
+
+    const uint8_t *image = SerialFlash.image();
+    uint32_t pages = 0;
+    for (uint32_t addr = 0; addr < HOST_FLASH_CAPACITY; addr += FLASH_PAGE_SIZE)
+    {
+        uint8_t frame[sizeof(uint32_t) + FLASH_PAGE_SIZE + sizeof(uint16_t)];
+        memcpy(&frame[sizeof(uint32_t)], &image[addr], FLASH_PAGE_SIZE);
+
+        bool erased = true;
+        for (int i = 0; erased && i < FLASH_PAGE_SIZE; ++i)
+            erased = image[addr + i] == 0xFF;
+        if (erased)
+            continue;
+
+        memcpy(frame, &addr, sizeof(uint32_t));
+        uint16_t crc = flash_image_crc(FLASH_IMAGE_CRC_INIT, frame, sizeof(uint32_t) + FLASH_PAGE_SIZE);
+        memcpy(&frame[sizeof(uint32_t) + FLASH_PAGE_SIZE], &crc, sizeof(crc));
+        if (!send_command(fd, FLASH_IMAGE_PAGE, frame, sizeof(frame)))
+        {
+            fprintf(stderr, "The board did not program the page at 0x%06x.\n", addr);
+            close(fd);
+            return false;
+        }
+        ++pages;
+    }
+
+    bool status = send_command(fd, FLASH_IMAGE_DONE);
+    close(fd);
+
+    fprintf(stderr, "Programmed %u pages.\n", pages);
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *profile = "test";
+    const char *output = "flash.img";
+    const char *input = nullptr;
+    const char *device = nullptr;
+    int first_year = 22;
+    int last_year = 23;
+    bool list = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:y:Y:s:o:i:ld:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            profile = optarg;
+            break;
+        case 'y':
+            first_year = atoi(optarg);
+            break;
+        case 'Y':
+            last_year = atoi(optarg);
+            break;
+        case 's':
+            srand(atoi(optarg));
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'i':
+            input = optarg;
+            break;
+        case 'l':
+            list = true;
+            break;
+        case 'd':
+            device = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    SerialFlash.begin(SPI, 0);
+
+    if (input)
+    {
+        if (!SerialFlash.load_image(input))
+        {
+            perror(input);
+            return 1;
+        }
+    }
+    else
+    {
+        if (!build_image(profile, first_year, last_year))
+            return 1;
+
+        if (!SerialFlash.save_image(output))
+        {
+            perror(output);
+            return 1;
+        }
+    }
+
+    if (list)
+        list_image();
+
+    if (device && !flash_board(device))
+        return 1;
+
+    return 0;
+}
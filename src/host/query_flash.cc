@@ -0,0 +1,52 @@
+/**
+ * Run queries against a flash image on the host. This is the query
+ * interpreter the board runs (flash_query.cc), with the chip replaced by
+ * lib/host_flash and the serial port by stdin and stdout:
+ *
+ *   echo "q 1 1640995200 1641081599 6 0" | query_flash flash.img | tools/query_decode.py -
+ *
+ * Images can be made with make_flash_image.
+ */
+
+#include <Arduino.h>
+
+#include <SerialFlash.h>
+
+#include "flash_query.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s image < queries\n", argv[0]);
+        return 1;
+    }
+
+    SerialFlash.begin(SPI, 0);
+    if (!SerialFlash.load_image(argv[1]))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    char command[QUERY_COMMAND_SIZE];
+    while (fgets(command, sizeof(command), stdin))
+    {
+        size_t len = strcspn(command, "\r\n");
+        if (command[len] == '\0' && !feof(stdin))
+        {
+            // Too long; skip the rest of the line and reject it, as the board does
+            int c;
+            while ((c = getchar()) != EOF && c != '\n')
+                ;
+            reject_query(SerialUSB);
+            continue;
+        }
+
+        command[len] = '\0';
+        if (command[0])
+            run_query(command, SerialUSB);
+    }
+
+    return 0;
+}
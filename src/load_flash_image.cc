@@ -0,0 +1,112 @@
+/**
+ * Program a flash image sent from the host by make_flash_image -d. See
+ * flash_image.h for the protocol.
+ */
+
+#include <Arduino.h>
+
+#include <string.h>
+
+#include <SPI.h>
+
+#include <SerialFlash.h>
+
+#include "flash_utils.h"
+#include "flash_image.h"
+#include "binlog.h"
+
+#define STATUS_LED 13
+#define LORA_CS 5
+
+#define BAUD 115200
+#define Serial SerialUSB
+
+#ifndef JLINK
+#define JLINK 0
+#endif
+
+#ifndef VERBOSE
+#define VERBOSE 0
+#endif
+
+static uint32_t chip_size = 0; // bytes
+
+/**
+ * @brief Read one page from the host, program it and read it back
+ * @return True if the page was written, false if the host didn't send it
+ * all, the CRC or address was wrong or the page did not read back.
+ */
+static bool program_page()
+{
+    uint32_t address;
+    uint8_t page[FLASH_PAGE_SIZE];
+    uint16_t crc;
+
+    if (Serial.readBytes((char *)&address, sizeof(address)) != sizeof(address) ||
+        Serial.readBytes((char *)page, sizeof(page)) != sizeof(page) ||
+        Serial.readBytes((char *)&crc, sizeof(crc)) != sizeof(crc))
+        return false;
+
+    uint16_t expected = flash_image_crc(FLASH_IMAGE_CRC_INIT, (const uint8_t *)&address, sizeof(address));
+    expected = flash_image_crc(expected, page, sizeof(page));
+    if (crc != expected || address % FLASH_PAGE_SIZE != 0 || address >= chip_size)
+        return false;
+
+    SerialFlash.write(address, page, sizeof(page));
+
+    uint8_t check[FLASH_PAGE_SIZE];
+    SerialFlash.read(address, check, sizeof(check));
+
+    return memcmp(page, check, sizeof(page)) == 0;
+}
+
+void setup()
+{
+    pinMode(STATUS_LED, OUTPUT);
+    digitalWrite(STATUS_LED, HIGH);
+    pinMode(LORA_CS, OUTPUT);
+    digitalWrite(LORA_CS, HIGH);
+
+    Serial.begin(BAUD);
+
+#if JLINK == 0
+    // Wait for serial port to be available
+    while (!Serial)
+        ;
+#endif
+
+    Serial.println("Start Flash Image Loader");
+
+    chip_size = setup_spi_flash(false, VERBOSE);
+    binlog_flush();
+}
+
+void loop()
+{
+    if (!Serial.available())
+        return;
+
+    bool status;
+    switch (Serial.read())
+    {
+    case FLASH_IMAGE_ERASE:
+        erase_flash();
+        status = true;
+        break;
+
+    case FLASH_IMAGE_PAGE:
+        status = program_page();
+        break;
+
+    case FLASH_IMAGE_DONE:
+        while (!SerialFlash.ready())
+            ;
+        status = true;
+        break;
+
+    default:
+        return; // not a command; ignore it
+    }
+
+    Serial.write((uint8_t)(status ? FLASH_IMAGE_ACK : FLASH_IMAGE_NAK));
+}
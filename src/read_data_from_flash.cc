@@ -15,6 +15,10 @@
 #include <SerialFlash.h>
 
 #include "flash_utils.h"
+#include "flash_stats.h"
+#include "record_types.h"
+#include "binlog.h"
+#include "flash_query.h"
 
 #define STATUS_LED 13
 #define LORA_CS 5
@@ -64,10 +68,11 @@ bool parse_filename(const char *filename, int &month, int &year)
 
 /**
  * @brief Read data from a file. 
- * This function expects that there will be a 6 byte (3 field) header followed
- * by N records and that each record will be 11 bytes. It checks that the file
- * exists and can be opened. It checks that number of records match the samples
- * per day scheme.
+ * This function expects that there will be a 10 byte (5 field) header followed
+ * by N records. The header's record type is used to find the size of the
+ * records and how to decode them (see record_types.h). It checks that the file
+ * exists and can be opened. For the test records, it checks that number of
+ * records match the samples per day scheme.
  * 
  * @todo Modify for real use.
  * 
@@ -79,6 +84,7 @@ bool parse_filename(const char *filename, int &month, int &year)
 bool read_file_data(const char *filename, bool verbose = false)
 {
     if (!SerialFlash.exists(filename)) {
+        binlog_flush();
         Serial.print("The file does not exist: ");
         Serial.println(filename);
         return false;
@@ -86,6 +92,7 @@ bool read_file_data(const char *filename, bool verbose = false)
 
     flashFile = SerialFlash.open(filename);
     if (!flashFile) {
+        binlog_flush();
         Serial.print("Could not open: ");
         Serial.println(filename);
         return false;
@@ -99,62 +106,72 @@ bool read_file_data(const char *filename, bool verbose = false)
     bool header_status = read_header_from_file(flashFile, header_year, header_month, num_records, record_size, record_type);
     if (!header_status)
     {
+        binlog_flush();
         Serial.println("Could not read the data file header.");
         return false;
     }
 
-    char msg[256];
-    snprintf(msg, sizeof(msg), "Header: year: %d, month %d, number of records: %d, size %d and type %02x", 
-            header_year, header_month, num_records, record_size, record_type);
-    Serial.println(msg);
+    binlog(BINLOG_HEADER, header_year, header_month, num_records, record_size, record_type);
 
-    char record[11];
-    const int samples_per_day = 24;
-    const int dpm = days_per_month(header_month, header_year);
-    if (dpm * samples_per_day != num_records)
+    const record_type_info *info = find_record_type(record_type);
+    if (!info)
     {
-        char msg[256];
-        snprintf(msg, sizeof(msg), "Expected records (%d) and number in header (%d) do not match",
-                 dpm * samples_per_day, num_records);
-        Serial.println(msg);
+        binlog(BINLOG_UNKNOWN_TYPE, record_type);
+        binlog_flush();
+        return false;
     }
-    
-    // read the data.
-    uint16_t message = 0;
-    for (int i = 0; i < num_records; ++i)
+
+    if (info->size != RECORD_SIZE_VARIABLE && info->size != record_size)
     {
-        bool rd_status = read_record_from_file(flashFile, record, sizeof(record));
-        if (!rd_status)
+        binlog(BINLOG_RECORD_SIZE, record_type, info->size, record_size);
+        binlog_flush();
+        return false;
+    }
+
+    if (record_type == RECORD_TYPE_01)
+    {
+        const int samples_per_day = 24;
+        const int dpm = days_per_month(header_month, header_year);
+        if (dpm * samples_per_day != num_records)
         {
-            Serial.print("Failed to read record number: ");
-            Serial.println(message);
-            continue;
+            binlog(BINLOG_RECORD_COUNT, dpm * samples_per_day, num_records);
         }
+    }
 
-        // first two bytes are the message num. filler after that.
-        memcpy(&message, record, sizeof(message));
-        if (message != i + 1)
+    // read the data.
+    bool status = true;
+    char record[RECORD_MAX_SIZE];
+    // Variable-length records are read until RECORD_END; short records let
+    // more than num_records fit in the file.
+    for (int i = 0; info->size == RECORD_SIZE_VARIABLE || i < num_records; ++i)
+    {
+        uint16_t size = info->size;
+        if (info->size == RECORD_SIZE_VARIABLE)
         {
-            Serial.print("Invalid message number: ");
-            Serial.print(message);
-            Serial.print(", expected: ");
-            Serial.println(i + 1);
+            record_status rd_status = read_variable_record_from_file(flashFile, record, sizeof(record), size);
+            if (rd_status == RECORD_END)
+                break;
+
+            if (rd_status == RECORD_ERROR)
+            {
+                // The next record's position is unknown, so stop.
+                binlog(BINLOG_READ_FAILED, i + 1);
+                status = false;
+                break;
+            }
         }
-
-        char filler[9] = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
-        if (memcmp(&record[2], filler, sizeof(filler)) != 0)
-            Serial.println("Invalid record filler");
-
-        if (verbose)
+        else if (!read_record_from_file(flashFile, record, size))
         {
-            char msg[256];
-            snprintf(msg, sizeof(msg), "record number: %d, data: %02x %02x %02x %02x %02x %02x %02x %02x %02x",
-                        message, record[2], record[3], record[4], record[5], record[6], record[7], record[8], record[9], record[10]);
-            SerialUSB.println(msg);
+            binlog(BINLOG_READ_FAILED, i + 1);
+            status = false;
+            continue;
         }
+
+        info->decode(record, size, i, verbose);
     }
 
-    return true;
+    binlog_flush();
+    return status;
 }
 
 void setup()
@@ -200,6 +217,47 @@ void setup()
     }
 }
 
+/**
+ * After the files are listed, answer queries (see flash_query.h), one per
+ * line, and the stats commands.
+ */
 void loop()
 {
-}
\ No newline at end of file
+    static char command[QUERY_COMMAND_SIZE];
+    static unsigned int len = 0;
+    static bool overflow = false; // the line is too long for 'command'
+
+    binlog_drain();
+
+    while (Serial.available())
+    {
+        int c = Serial.read();
+#if FLASH_STATS
+        if (len == 0 && flash_stats_command(c))
+            continue;
+#endif
+        if (c == '\n' || c == '\r')
+        {
+            // Running what fit of a long line could answer a different query
+            if (overflow)
+            {
+                reject_query(Serial);
+            }
+            else if (len > 0)
+            {
+                command[len] = '\0';
+                run_query(command, Serial);
+            }
+            len = 0;
+            overflow = false;
+        }
+        else if (len < sizeof(command) - 1)
+        {
+            command[len++] = c;
+        }
+        else
+        {
+            overflow = true;
+        }
+    }
+}
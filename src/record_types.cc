@@ -0,0 +1,221 @@
+// A registry of the record types that can be stored in a data file.
+
+/**
+ * The record_type in each data file header is used to look up the record's
+ * size and a decoder for it. Fixed-size records are stored back to back;
+ * variable-length records (size RECORD_SIZE_VARIABLE) are each prefixed by
+ * their length (see write_variable_record_to_file()). For a file of
+ * variable-length records, the header's record_size is the largest record
+ * the writer will store and num_records is the number of those largest
+ * records the file was sized for (see make_new_variable_data_file(), which
+ * leaves room for the length prefixes). Shorter records let more than
+ * num_records fit, so readers don't use it as a count; the records end at
+ * the first unwritten (0xFFFF) length or the end of the file.
+ *
+ * Each type also says how to get the time of a record and how its bytes
+ * divide into fields, so queries (see flash_query.cc) can select records
+ * by time and send only some of their fields.
+ *
+ * The types used by the test programs are registered here. Others can be
+ * added at run time with register_record_type() and add_record_field().
+ */
+
+#include <Arduino.h>
+
+#include <string.h>
+
+#include "flash_utils.h"
+#include "record_types.h"
+#include "binlog.h"
+
+#define SAMPLES_PER_DAY 24
+#define SECONDS_PER_DAY 86400UL
+
+/**
+ * @brief RECORD_TYPE_01 is the 11-byte test record
+ * The first two bytes are the message number, starting at one. The
+ * remaining nine bytes are 0xAA.
+ */
+static bool decode_type_01(const char *record, const uint16_t record_size, const uint16_t index, bool verbose)
+{
+    bool status = true;
+
+    uint16_t message = 0;
+    memcpy(&message, record, sizeof(message));
+    if (message != index + 1)
+    {
+        binlog(BINLOG_INVALID_MESSAGE, message, index + 1);
+        status = false;
+    }
+
+    const uint8_t filler[9] = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
+    if (memcmp(&record[2], filler, sizeof(filler)) != 0)
+    {
+        binlog(BINLOG_INVALID_FILLER);
+        status = false;
+    }
+
+    if (verbose)
+    {
+        const uint8_t *data = (const uint8_t *)record;
+        binlog(BINLOG_RECORD_01, message, data[2], data[3], data[4], data[5], data[6], data[7], data[8], data[9], data[10]);
+    }
+
+    return status;
+}
+
+/**
+ * @brief The test records are taken once an hour starting at midnight on
+ * the first day of the month
+ */
+static uint32_t time_type_01(const char *record, const uint16_t record_size, const uint16_t index, const uint32_t file_start)
+{
+    return file_start + index * (SECONDS_PER_DAY / SAMPLES_PER_DAY);
+}
+
+/**
+ * @brief RECORD_TYPE_02 is a variable-length event record
+ * The first four bytes are the time of the event (seconds since the epoch),
+ * the rest is event data that is not interpreted here.
+ */
+static bool decode_type_02(const char *record, const uint16_t record_size, const uint16_t index, bool verbose)
+{
+    if (record_size < sizeof(uint32_t))
+    {
+        binlog(BINLOG_EVENT_TOO_SHORT, index);
+        return false;
+    }
+
+    if (verbose)
+    {
+        uint32_t event_time;
+        memcpy(&event_time, record, sizeof(event_time));
+
+        binlog(BINLOG_EVENT, index, event_time, record_size - sizeof(event_time));
+    }
+
+    return true;
+}
+
+static uint32_t time_type_02(const char *record, const uint16_t record_size, const uint16_t index, const uint32_t file_start)
+{
+    uint32_t event_time = 0;
+    if (record_size >= sizeof(event_time))
+        memcpy(&event_time, record, sizeof(event_time));
+
+    return event_time;
+}
+
+static record_type_info record_types[RECORD_TYPES_MAX] = {
+    {RECORD_TYPE_01, 11, "test", decode_type_01, time_type_01, 2, {{0, 2}, {2, 9}}},          // message, filler
+    {RECORD_TYPE_02, RECORD_SIZE_VARIABLE, "event", decode_type_02, time_type_02, 2, {{0, 4}, {4, 0}}}, // time, data
+};
+
+static int num_record_types = 2;
+
+/**
+ * @brief Add a record type to the registry.
+ * @param type The record type ID written in the file header
+ * @param size The number of bytes in each record, or RECORD_SIZE_VARIABLE
+ * @param name A short name for the type. Not copied.
+ * @param decode Function that checks and/or prints one record
+ * @param time Function that returns the time of one record. If null, the
+ * type cannot be queried by time.
+ * @return True if the type was added, false if it is already registered,
+ * too large to read or the registry is full.
+ */
+bool register_record_type(const uint16_t type, const uint16_t size, const char *name, record_decoder decode,
+                          record_time time)
+{
+    if (find_record_type(type) || size > RECORD_MAX_SIZE || num_record_types == RECORD_TYPES_MAX)
+        return false;
+
+    record_types[num_record_types].type = type;
+    record_types[num_record_types].size = size;
+    record_types[num_record_types].name = name;
+    record_types[num_record_types].decode = decode;
+    record_types[num_record_types].time = time;
+    record_types[num_record_types].num_fields = 0;
+    ++num_record_types;
+
+    return true;
+}
+
+/**
+ * @brief The offset of the first byte after a field
+ * @param field The field
+ * @param record_size The size of the records, or RECORD_SIZE_VARIABLE
+ */
+static uint16_t field_end(const record_field &field, const uint16_t record_size)
+{
+    uint16_t max_size = record_size == RECORD_SIZE_VARIABLE ? RECORD_MAX_SIZE : record_size;
+    return field.size == 0 ? max_size : field.offset + field.size;
+}
+
+/**
+ * @brief Add a field to a registered record type
+ * @param type The record type ID
+ * @param offset The offset of the field in the record
+ * @param size The size of the field in bytes, or zero for the rest of the record
+ * @return True if the field was added, false if the type is unknown, has
+ * RECORD_FIELDS_MAX fields already, or the field does not fit in the record
+ * or overlaps another field.
+ */
+bool add_record_field(const uint16_t type, const uint8_t offset, const uint8_t size)
+{
+    record_type_info *info = (record_type_info *)find_record_type(type);
+    if (!info || info->num_fields == RECORD_FIELDS_MAX)
+        return false;
+
+    const record_field field = {offset, size};
+    const uint16_t max_size = info->size == RECORD_SIZE_VARIABLE ? RECORD_MAX_SIZE : info->size;
+    if (offset >= max_size || field_end(field, info->size) > max_size)
+        return false;
+
+    for (uint8_t f = 0; f < info->num_fields; ++f)
+    {
+        const record_field &other = info->fields[f];
+        if (offset < field_end(other, info->size) && other.offset < field_end(field, info->size))
+            return false;
+    }
+
+    info->fields[info->num_fields].offset = offset;
+    info->fields[info->num_fields].size = size;
+    ++info->num_fields;
+
+    return true;
+}
+
+/**
+ * @brief Look up a record type
+ * @param type The record type ID from the file header
+ * @return A pointer to the type's info or nullptr if the type is unknown.
+ */
+const record_type_info *find_record_type(const uint16_t type)
+{
+    for (int i = 0; i < num_record_types; ++i)
+    {
+        if (record_types[i].type == type)
+            return &record_types[i];
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief The time at the start of a month
+ * Data files hold one month each; this is the time of their first record.
+ * @param month The month number
+ * @param yy The last two digits of the year
+ * @return Seconds since the epoch (UTC) at midnight on the first of the month.
+ */
+uint32_t month_start_time(const uint16_t month, const uint16_t yy)
+{
+    uint32_t days = 0;
+    for (uint16_t year = 1970; year < yy + 2000; ++year)
+        days += is_leap(year) ? 366 : 365;
+    for (uint16_t m = 1; m < month; ++m)
+        days += days_per_month(m, yy);
+
+    return days * SECONDS_PER_DAY;
+}
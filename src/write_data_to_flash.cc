@@ -14,6 +14,9 @@
 #include <SerialFlash.h>
 
 #include "flash_utils.h"
+#include "record_types.h"
+#include "flash_stats.h"
+#include "binlog.h"
 
 #define STATUS_LED 13
 #define LORA_CS 5
@@ -98,70 +101,61 @@ bool read_test_data(int month, int year, bool verbose = false)
     flashFile = SerialFlash.open(file_name);
     if (!flashFile)
     {
+        binlog_flush();
         Serial.print("Could not open: ");
         Serial.println(file_name);
         return false;
     }
 
-    char msg[256];
-    snprintf(msg, sizeof(msg), "File %s starts at 0x%08lx", file_name, flashFile.getFlashAddress());
-    Serial.println(msg);
+    binlog(BINLOG_FILE_START, month, year, flashFile.getFlashAddress());
 
     // read the header
     uint16_t header_year, header_month, num_records, record_size, record_type;
     bool header_status = read_header_from_file(flashFile, header_year, header_month, num_records, record_size, record_type);
     if (!header_status)
     {
+        binlog_flush();
         Serial.println("Could not read the data file header.");
         return false;
     }
 
-    snprintf(msg, sizeof(msg), "year: %d, Month %d, number of records: %d, record size %d and type %02x",
-             header_year, header_month, num_records, record_size, record_type);
-    Serial.println(msg);
+    binlog(BINLOG_TEST_HEADER, header_year, header_month, num_records, record_size, record_type);
+
+    const record_type_info *info = find_record_type(record_type);
+    if (!info)
+    {
+        binlog(BINLOG_UNKNOWN_TYPE, record_type);
+        binlog_flush();
+        return false;
+    }
+
+    if (info->size == RECORD_SIZE_VARIABLE || info->size != record_size)
+    {
+        binlog(BINLOG_RECORD_SIZE, record_type, info->size, record_size);
+        binlog_flush();
+        return false;
+    }
 
-    // read the data.
-    uint16_t message = 0;
-    char record[11];
     const int samples_per_day = 24;
     const int dpm = days_per_month(month, year);
+    if (dpm * samples_per_day != num_records)
+        binlog(BINLOG_RECORD_COUNT, dpm * samples_per_day, num_records);
 
-    for (int i = 0; i < dpm; ++i)
+    // read the data; the decoder checks the message numbers and filler.
+    char record[RECORD_MAX_SIZE];
+    for (int i = 0; i < num_records; ++i)
     {
-        for (int j = 0; j < samples_per_day; ++j)
+        if (!read_record_from_file(flashFile, record, record_size))
         {
-            bool rd_status = read_record_from_file(flashFile, record, sizeof(record));
-            if (!rd_status)
-            {
-                Serial.print("Failed to read record number: ");
-                Serial.println(message);
-                return false;
-            }
-
-            // first two bytes are the message num. filler after that.
-            memcpy(&message, record, sizeof(message));
-            if (message != (j + 1) + (i * samples_per_day))
-            {
-                Serial.print("Invalid message number: ");
-                Serial.print(message);
-                Serial.print(", expected: ");
-                Serial.println((j + 1) + (i * samples_per_day));
-            }
-
-            char filler[9] = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
-            if (memcmp(&record[2], filler, sizeof(filler)) != 0)
-                Serial.println("Invalid record filler");
-
-            if (verbose)
-            {
-                char msg[256];
-                snprintf(msg, sizeof(msg), "record number: %d, data: %02x %02x %02x %02x %02x %02x %02x %02x %02x",
-                         message, record[2], record[3], record[4], record[5], record[6], record[7], record[8], record[9], record[10]);
-                SerialUSB.println(msg);
-            }
+            binlog(BINLOG_READ_FAILED, i + 1);
+            binlog_flush();
+            return false;
         }
+
+        info->decode(record, record_size, i, verbose);
     }
 
+    binlog_flush();
     return true;
 }
 
@@ -212,4 +206,10 @@ void setup()
 
 void loop()
 {
-}
\ No newline at end of file
+    binlog_drain();
+
+#if FLASH_STATS
+    if (Serial.available())
+        flash_stats_command(Serial.read());
+#endif
+}
@@ -0,0 +1,245 @@
+// Host tests for flash_query.cc, run with 'pio test -e native'. The flash
+// chip is the RAM array in lib/host_flash and the frames are captured by a
+// Print instead of going to the serial port.
+
+#include <Arduino.h>
+
+#include <string.h>
+
+#include <SerialFlash.h>
+
+#include <unity.h>
+
+#include "flash_utils.h"
+#include "record_types.h"
+#include "flash_query.h"
+
+#define RECORDS_PER_FILE 48 // two days of hourly test records
+#define JANUARY_2022 1640995200UL
+#define FEBRUARY_2022 1643673600UL
+#define HOUR 3600UL
+
+// Keeps everything written to it so the frames can be checked.
+class CapturePrint : public Print
+{
+public:
+    uint8_t data[8192];
+    size_t len = 0;
+    size_t pos = 0; // next byte for next_frame()
+
+    size_t write(uint8_t c)
+    {
+        if (len == sizeof(data))
+            return 0;
+        data[len++] = c;
+        return 1;
+    }
+};
+
+struct frame
+{
+    uint8_t type;
+    uint16_t len;
+    const uint8_t *payload;
+};
+
+static CapturePrint out;
+
+static uint16_t get_uint16(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t get_uint32(const uint8_t *buf)
+{
+    return get_uint16(buf) | ((uint32_t)get_uint16(buf + 2) << 16);
+}
+
+/**
+ * @brief Read the next captured frame and check its sync byte and checksum
+ * @return True if there was a whole, valid frame, false otherwise.
+ */
+static bool next_frame(frame &f)
+{
+    if (out.pos + 4 > out.len || out.data[out.pos] != QUERY_SYNC)
+        return false;
+
+    f.type = out.data[out.pos + 1];
+    f.len = get_uint16(&out.data[out.pos + 2]);
+    f.payload = &out.data[out.pos + 4];
+    if (out.pos + 4 + f.len + 1 > out.len)
+        return false;
+
+    uint8_t checksum = 0;
+    for (uint16_t i = 0; i < f.len; ++i)
+        checksum ^= f.payload[i];
+    if (checksum != f.payload[f.len])
+        return false;
+
+    out.pos += 4 + f.len + 1;
+    return true;
+}
+
+/**
+ * @brief Check that the next frame is the END frame with 'count' and 'status'
+ * and that nothing follows it.
+ */
+static void check_end(const uint32_t count, const query_status status)
+{
+    frame f;
+    TEST_ASSERT_TRUE(next_frame(f));
+    TEST_ASSERT_EQUAL_INT(QUERY_FRAME_END, f.type);
+    TEST_ASSERT_EQUAL_UINT16(5, f.len);
+    TEST_ASSERT_EQUAL_UINT32(count, get_uint32(f.payload));
+    TEST_ASSERT_EQUAL_INT(status, f.payload[4]);
+    TEST_ASSERT_EQUAL_UINT32(out.len, out.pos);
+}
+
+/**
+ * @brief Write a file of RECORD_TYPE_01 records like write_data_to_flash.cc;
+ * the message of record i is i + 1.
+ */
+static void make_test_file(const char *filename, const uint16_t month)
+{
+    SerialFlashFile file;
+    TEST_ASSERT_TRUE(make_new_data_file(file, filename, RECORDS_PER_FILE, 11));
+    TEST_ASSERT_TRUE(write_header_to_file(file, 22, month, RECORDS_PER_FILE, 11, RECORD_TYPE_01));
+
+    char record[11];
+    memset(record, 0xAA, sizeof(record));
+    for (uint16_t i = 0; i < RECORDS_PER_FILE; ++i)
+    {
+        record[0] = (i + 1) & 0xFF;
+        record[1] = (i + 1) >> 8;
+        TEST_ASSERT_TRUE(write_record_to_file(file, record, sizeof(record)));
+    }
+
+    file.close();
+}
+
+void setUp()
+{
+    SerialFlash.eraseAll();
+    make_test_file("jan-22.bin", 1);
+    make_test_file("feb-22.bin", 2);
+    out.len = 0;
+    out.pos = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_range_across_two_months()
+{
+    char command[QUERY_COMMAND_SIZE];
+    snprintf(command, sizeof(command), "q 1 %lu %lu", JANUARY_2022 + 40 * HOUR, FEBRUARY_2022 + 5 * HOUR);
+    TEST_ASSERT_TRUE(run_query(command, out));
+
+    const uint16_t months[] = {1, 2};
+    const uint16_t firsts[] = {40, 0};
+    const uint16_t lasts[] = {RECORDS_PER_FILE - 1, 5};
+    const uint32_t starts[] = {JANUARY_2022, FEBRUARY_2022};
+    uint32_t count = 0;
+    frame f;
+    for (int m = 0; m < 2; ++m)
+    {
+        TEST_ASSERT_TRUE(next_frame(f));
+        TEST_ASSERT_EQUAL_INT(QUERY_FRAME_FILE, f.type);
+        TEST_ASSERT_EQUAL_UINT16(6, f.len);
+        TEST_ASSERT_EQUAL_UINT16(22, get_uint16(f.payload));
+        TEST_ASSERT_EQUAL_UINT16(months[m], get_uint16(f.payload + 2));
+        TEST_ASSERT_EQUAL_UINT16(RECORDS_PER_FILE, get_uint16(f.payload + 4));
+
+        for (uint16_t i = firsts[m]; i <= lasts[m]; ++i)
+        {
+            TEST_ASSERT_TRUE(next_frame(f));
+            TEST_ASSERT_EQUAL_INT(QUERY_FRAME_RECORD, f.type);
+            TEST_ASSERT_EQUAL_UINT16(6 + 11, f.len);
+            TEST_ASSERT_EQUAL_UINT16(i, get_uint16(f.payload));
+            TEST_ASSERT_EQUAL_UINT32(starts[m] + i * HOUR, get_uint32(f.payload + 2));
+            TEST_ASSERT_EQUAL_UINT16(i + 1, get_uint16(f.payload + 6));
+            ++count;
+        }
+    }
+
+    check_end(count, QUERY_OK);
+    TEST_ASSERT_EQUAL_UINT32(14, count);
+}
+
+void test_every_nth_record()
+{
+    char command[QUERY_COMMAND_SIZE];
+    snprintf(command, sizeof(command), "q 1 %lu %lu 4", JANUARY_2022 + 2 * HOUR, JANUARY_2022 + 20 * HOUR);
+    TEST_ASSERT_TRUE(run_query(command, out));
+
+    frame f;
+    TEST_ASSERT_TRUE(next_frame(f));
+    TEST_ASSERT_EQUAL_INT(QUERY_FRAME_FILE, f.type);
+
+    // The count starts at the first record in the range, not the first in the file.
+    for (uint16_t i = 2; i <= 20; i += 4)
+    {
+        TEST_ASSERT_TRUE(next_frame(f));
+        TEST_ASSERT_EQUAL_INT(QUERY_FRAME_RECORD, f.type);
+        TEST_ASSERT_EQUAL_UINT16(i, get_uint16(f.payload));
+    }
+
+    check_end(5, QUERY_OK);
+}
+
+void test_field_subset()
+{
+    char command[QUERY_COMMAND_SIZE];
+    snprintf(command, sizeof(command), "q 1 %lu %lu 1 0", FEBRUARY_2022, FEBRUARY_2022 + 2 * HOUR);
+    TEST_ASSERT_TRUE(run_query(command, out));
+
+    frame f;
+    TEST_ASSERT_TRUE(next_frame(f));
+    TEST_ASSERT_EQUAL_INT(QUERY_FRAME_FILE, f.type);
+    TEST_ASSERT_EQUAL_UINT16(2, get_uint16(f.payload + 2));
+
+    for (uint16_t i = 0; i <= 2; ++i)
+    {
+        TEST_ASSERT_TRUE(next_frame(f));
+        TEST_ASSERT_EQUAL_INT(QUERY_FRAME_RECORD, f.type);
+        TEST_ASSERT_EQUAL_UINT16(6 + 2, f.len); // only the message
+        TEST_ASSERT_EQUAL_UINT16(i + 1, get_uint16(f.payload + 6));
+    }
+
+    check_end(3, QUERY_OK);
+}
+
+void test_unknown_type()
+{
+    TEST_ASSERT_FALSE(run_query("q 7 0 4294967295", out));
+    check_end(0, QUERY_UNKNOWN_TYPE);
+}
+
+void test_bad_command()
+{
+    const char *commands[] = {"x 1 0 10", "q 1 0", "q 1 0 10 0", "q 1 0 10 1 9", "q 1 0 10 junk"};
+    for (unsigned int i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i)
+    {
+        TEST_ASSERT_FALSE(run_query(commands[i], out));
+        check_end(0, QUERY_BAD_COMMAND);
+    }
+}
+
+void test_reject_query()
+{
+    reject_query(out);
+    check_end(0, QUERY_BAD_COMMAND);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_range_across_two_months);
+    RUN_TEST(test_every_nth_record);
+    RUN_TEST(test_field_subset);
+    RUN_TEST(test_unknown_type);
+    RUN_TEST(test_bad_command);
+    RUN_TEST(test_reject_query);
+    return UNITY_END();
+}
@@ -0,0 +1,147 @@
+// Host tests for flash_streams.cc, run with 'pio test -e native'. The flash
+// chip is the RAM array in lib/host_flash.
+
+#include <Arduino.h>
+
+#include <SerialFlash.h>
+
+#include <unity.h>
+
+#include "flash_utils.h"
+#include "flash_streams.h"
+
+/**
+ * @brief Fill a record with bytes that depend on the stream and record number.
+ */
+static void make_record(char *record, const int record_size, const int stream, const int number)
+{
+    for (int i = 0; i < record_size; ++i)
+        record[i] = (char)(stream * 64 + number + i);
+}
+
+void setUp()
+{
+    SerialFlash.eraseAll();
+}
+
+void tearDown()
+{
+}
+
+void test_streams_round_trip()
+{
+    const char *names[] = {"stream-0.bin", "stream-1.bin", "stream-2.bin"};
+    const uint16_t sizes[] = {3, 11, 50};
+    const uint16_t counts[] = {300, 120, 40};
+    const int num_streams = 3;
+
+    int streams[num_streams];
+    for (int i = 0; i < num_streams; ++i)
+    {
+        streams[i] = open_flash_stream(names[i], 2024, i + 1, counts[i], sizes[i], RECORD_TYPE_01);
+        TEST_ASSERT_TRUE(streams[i] >= 0);
+    }
+
+    char record[64];
+    for (int n = 0; n < counts[0]; ++n)
+    {
+        for (int i = 0; i < num_streams; ++i)
+        {
+            if (n >= counts[i])
+                continue;
+            make_record(record, sizes[i], i, n);
+            TEST_ASSERT_TRUE(push_stream_record(streams[i], record));
+        }
+        service_flash_streams();
+    }
+
+    for (int i = 0; i < num_streams; ++i)
+    {
+        TEST_ASSERT_EQUAL_UINT32(0, stream_drops(streams[i]));
+        TEST_ASSERT_TRUE(close_flash_stream(streams[i]));
+    }
+
+    for (int i = 0; i < num_streams; ++i)
+    {
+        SerialFlashFile file = SerialFlash.open(names[i]);
+        TEST_ASSERT_TRUE(file);
+
+        uint16_t year, month, num_records, record_size, record_type;
+        TEST_ASSERT_TRUE(read_header_from_file(file, year, month, num_records, record_size, record_type));
+        TEST_ASSERT_EQUAL_UINT16(2024, year);
+        TEST_ASSERT_EQUAL_UINT16(i + 1, month);
+        TEST_ASSERT_EQUAL_UINT16(counts[i], num_records);
+        TEST_ASSERT_EQUAL_UINT16(sizes[i], record_size);
+        TEST_ASSERT_EQUAL_UINT16(RECORD_TYPE_01, record_type);
+
+        char expected[64];
+        for (int n = 0; n < counts[i]; ++n)
+        {
+            make_record(expected, sizes[i], i, n);
+            TEST_ASSERT_TRUE(read_record_from_file(file, record, sizes[i]));
+            TEST_ASSERT_EQUAL_MEMORY(expected, record, sizes[i]);
+        }
+
+        file.close();
+    }
+}
+
+void test_stream_backlog()
+{
+    int stream = open_flash_stream("backlog.bin", 2024, 1, 100, 11, RECORD_TYPE_01);
+    TEST_ASSERT_TRUE(stream >= 0);
+
+    char record[11];
+    make_record(record, sizeof(record), 0, 0);
+    TEST_ASSERT_TRUE(push_stream_record(stream, record));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(record), stream_backlog(stream));
+
+    // Less than the rest of the page is buffered, so nothing is written yet.
+    TEST_ASSERT_FALSE(service_flash_streams());
+    TEST_ASSERT_EQUAL_UINT32(sizeof(record), stream_backlog(stream));
+
+    TEST_ASSERT_TRUE(close_flash_stream(stream));
+    TEST_ASSERT_EQUAL_UINT32(0, stream_backlog(stream));
+}
+
+void test_stream_drops_when_full()
+{
+    int stream = open_flash_stream("full.bin", 2024, 1, 2, 11, RECORD_TYPE_01);
+    TEST_ASSERT_TRUE(stream >= 0);
+
+    char record[11];
+    make_record(record, sizeof(record), 0, 0);
+    TEST_ASSERT_TRUE(push_stream_record(stream, record));
+    TEST_ASSERT_TRUE(push_stream_record(stream, record));
+    TEST_ASSERT_FALSE(push_stream_record(stream, record));
+    TEST_ASSERT_EQUAL_UINT32(1, stream_drops(stream));
+
+    TEST_ASSERT_TRUE(close_flash_stream(stream));
+}
+
+void test_no_free_streams()
+{
+    int streams[FLASH_MAX_STREAMS];
+    char filename[16];
+    for (int i = 0; i < FLASH_MAX_STREAMS; ++i)
+    {
+        snprintf(filename, sizeof(filename), "s-%d.bin", i);
+        streams[i] = open_flash_stream(filename, 2024, 1, 10, 11, RECORD_TYPE_01);
+        TEST_ASSERT_TRUE(streams[i] >= 0);
+    }
+
+    TEST_ASSERT_EQUAL_INT(-1, open_flash_stream("extra.bin", 2024, 1, 10, 11, RECORD_TYPE_01));
+
+    for (int i = 0; i < FLASH_MAX_STREAMS; ++i)
+        TEST_ASSERT_TRUE(close_flash_stream(streams[i]));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_streams_round_trip);
+    RUN_TEST(test_stream_backlog);
+    RUN_TEST(test_stream_drops_when_full);
+    RUN_TEST(test_no_free_streams);
+    return UNITY_END();
+}
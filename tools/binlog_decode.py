@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Expand the binary log frames written by binlog() into text.
+
+The serial output of the test programs is a mix of ordinary text and
+binlog frames (see src/binlog.cc). Text is passed through as is; each frame
+is formatted using the format strings in include/binlog_formats.h. Query
+frames (see include/flash_query.h) are skipped; use query_decode.py for them.
+
+    binlog_decode.py /dev/cu.usbmodem112101     # read the board (needs pyserial)
+    binlog_decode.py capture.bin                # read a saved capture
+    cat capture.bin | binlog_decode.py -        # read stdin
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xB1
+HEADER_SIZE = 7  # sync, format, nargs, time
+
+QUERY_SYNC = 0xB2
+QUERY_HEADER_SIZE = 4  # sync, frame type, payload length
+
+DEFAULT_FORMATS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "include", "binlog_formats.h")
+
+CONVERSION = re.compile(r"%[-+ #0]*\d*(?:\.\d+)?(?:hh|h|ll|l|z)?([diuxXoc%])")
+
+
+def read_formats(path):
+    """Return the format strings from binlog_formats.h, indexed by ID."""
+    with open(path) as f:
+        text = f.read()
+    return [bytes(fmt, "ascii").decode("unicode_escape")
+            for fmt in re.findall(r'X\(\s*\w+\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', text)]
+
+
+def expand(fmt, args):
+    """Format the unsigned 32-bit 'args' using the C format string 'fmt'."""
+    values = iter(args)
+
+    def convert(m):
+        if m.group(1) == "%":
+            return "%"
+        value = next(values, 0)
+        if m.group(1) in "di" and value & 0x80000000:
+            value -= 1 << 32
+        spec = re.sub(r"(hh|h|ll|l|z)?[diuxXoc]$", "", m.group(0))
+        return (spec + {"i": "d", "u": "d"}.get(m.group(1), m.group(1))) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(stream, formats, out):
+    """Copy 'stream' to 'out', expanding the frames."""
+    buf = b""
+    while True:
+        data = stream.read(1)
+        if not data:
+            break
+        buf += data
+        if buf[0] == QUERY_SYNC:
+            # Frames can hold any byte, so skip the whole query frame by its
+            # length instead of looking for binlog frames inside it.
+            if len(buf) < QUERY_HEADER_SIZE:
+                continue
+            (length,) = struct.unpack_from("<H", buf, 2)
+            if len(buf) == QUERY_HEADER_SIZE + length + 1:  # + checksum
+                buf = b""
+            continue
+
+        if buf[0] != SYNC:
+            out.write(buf.decode("ascii", "replace"))
+            out.flush()
+            buf = b""
+            continue
+
+        if len(buf) < HEADER_SIZE:
+            continue
+        nargs = buf[2]
+        size = HEADER_SIZE + 4 * nargs
+        if len(buf) < size:
+            continue
+
+        fmt_id = buf[1]
+        (millis,) = struct.unpack_from("<I", buf, 3)
+        args = struct.unpack_from("<%dI" % nargs, buf, HEADER_SIZE)
+        if fmt_id < len(formats):
+            text = expand(formats[fmt_id], args)
+        else:
+            text = "unknown binlog format %d: %s" % (fmt_id, " ".join("%08x" % a for a in args))
+        out.write("[%10d ms] %s\n" % (millis, text))
+        out.flush()
+        buf = b""
+
+
+def open_input(name, baud):
+    if name == "-":
+        return sys.stdin.buffer
+    if name.startswith("/dev/"):
+        import serial  # pyserial
+
+        return serial.Serial(name, baud)
+    return open(name, "rb")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="serial device, capture file or - for stdin")
+    parser.add_argument("--formats", default=DEFAULT_FORMATS, help="path to binlog_formats.h")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    decode(open_input(args.input, args.baud), read_formats(args.formats), sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
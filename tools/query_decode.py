@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Print the frames sent in answer to a query (see include/flash_query.h).
+
+Anything on the port that is not a query frame is passed through as is,
+except binlog frames (see src/binlog.cc), which are skipped; use
+binlog_decode.py for them.
+
+    query_decode.py /dev/cu.usbmodem112101 -q "q 1 1640995200 1641081599"   # needs pyserial
+    query_flash flash.img < queries | query_decode.py -
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xB2
+BINLOG_SYNC = 0xB1
+STATUS = ["ok", "bad command", "unknown record type", "read error"]
+
+
+def read_exact(stream, n):
+    data = b""
+    while len(data) < n:
+        chunk = stream.read(n - len(data))
+        if not chunk:
+            raise EOFError
+        data += chunk
+    return data
+
+
+def decode(stream, out, stop_at_end=False):
+    """Print frames from 'stream'. Returns at EOF, or after an END frame if 'stop_at_end'."""
+    try:
+        while True:
+            c = read_exact(stream, 1)
+            if c[0] == BINLOG_SYNC:
+                # Frames can hold any byte, so skip the whole binlog frame by
+                # its length: format, nargs, time (4 bytes), args (4 bytes each).
+                _, nargs = read_exact(stream, 2)
+                read_exact(stream, 4 + 4 * nargs)
+                continue
+            if c[0] != SYNC:
+                out.write(c.decode("ascii", "replace"))
+                continue
+
+            kind, length = struct.unpack("<cH", read_exact(stream, 3))
+            payload = read_exact(stream, length)
+            (checksum,) = read_exact(stream, 1)
+            check = 0
+            for b in payload:
+                check ^= b
+            bad = "" if check == checksum else " (bad checksum)"
+
+            if kind == b"F":
+                year, month, num_records = struct.unpack("<HHH", payload)
+                out.write("file: year %d, month %d, %d records%s\n" % (year, month, num_records, bad))
+            elif kind == b"R":
+                index, t = struct.unpack_from("<HI", payload)
+                out.write("record %d, time %d: %s%s\n" % (index, t, payload[6:].hex(" "), bad))
+            elif kind == b"E":
+                count, status = struct.unpack("<IB", payload)
+                name = STATUS[status] if status < len(STATUS) else str(status)
+                out.write("end: %d records, %s%s\n" % (count, name, bad))
+                if stop_at_end:
+                    return
+            else:
+                out.write("unknown frame %r: %s%s\n" % (kind, payload.hex(" "), bad))
+    except EOFError:
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="serial device, capture file or - for stdin")
+    parser.add_argument("-q", "--query", help="send this query to the serial device first")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    if args.input == "-":
+        decode(sys.stdin.buffer, sys.stdout)
+    elif args.input.startswith("/dev/"):
+        import serial  # pyserial
+
+        port = serial.Serial(args.input, args.baud)
+        if args.query:
+            port.write((args.query + "\n").encode("ascii"))
+        decode(port, sys.stdout, stop_at_end=bool(args.query))
+    else:
+        with open(args.input, "rb") as f:
+            decode(f, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()